@@ -0,0 +1,333 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "stl_construct.h"
+#include "stl_uninitialized.h"
+#include "stl_vector.h"
+
+// 位向量 每个 bool 只占 1 bit, 按 64 位字存放
+// vector<bool> 每个元素占一个字节, bit_vector 只有它的 1/8
+// 计数, 区间置位, 按位与或等操作都是一次处理一整个字 (64 个元素)
+//
+// 约定: 最后一个字中超出 size() 的位始终为 0, count() 和 flip() 依赖这一点
+
+// 64 位字中第 k 个 (从 0 开始) 值为 1 的位的位置, 调用者保证 k < popcount(w)
+inline size_t __select_in_word(uint64_t w, size_t k) {
+#ifdef __BMI2__
+    // pdep 把 1 << k 放到 w 的第 k 个 1 上
+    return size_t(__builtin_ctzll(_pdep_u64(uint64_t(1) << k, w)));
+#else
+    // 去掉低位的 k 个 1 剩下最低的那个 1 就是答案
+    for (; k > 0; k--) w &= w - 1;
+    return size_t(__builtin_ctzll(w));
+#endif
+}
+
+template <typename Alloc = __default_alloc_template<false, 0>>
+class basic_bit_vector {
+public:
+    using word_type = uint64_t;
+    using size_type = size_t;
+
+    enum { word_bits = 64 };
+
+    basic_bit_vector() : nbits(0) {}
+
+    explicit basic_bit_vector(size_type n, bool value = false) : nbits(0) { resize(n, value); }
+
+    // 底层 vector 不能拷贝
+    basic_bit_vector(const basic_bit_vector&) = delete;
+    basic_bit_vector& operator=(const basic_bit_vector&) = delete;
+
+    size_type size() const { return nbits; }
+    bool empty() const { return nbits == 0; }
+
+    // 字的个数
+    size_type num_words() const { return words.size(); }
+    const word_type* data() const { return words.data(); }
+
+    bool test(size_type i) const { return (words.data()[i / word_bits] >> (i % word_bits)) & 1; }
+    bool operator[](size_type i) const { return test(i); }
+
+    void set(size_type i) { words.data()[i / word_bits] |= bit(i); }
+    void reset(size_type i) { words.data()[i / word_bits] &= ~bit(i); }
+    void flip(size_type i) { words.data()[i / word_bits] ^= bit(i); }
+
+    void set(size_type i, bool value) {
+        // 无分支: 先清零再或上 value
+        word_type& w = words.data()[i / word_bits];
+        w = (w & ~bit(i)) | (word_type(value) << (i % word_bits));
+    }
+
+    void push_back(bool value) {
+        if (nbits % word_bits == 0) {
+            words.push_back(0);
+        }
+        nbits++;
+        set(nbits - 1, value);
+    }
+
+    void resize(size_type n, bool value = false) {
+        const size_type old_bits = nbits;
+        words.resize(words_for(n), 0);
+        nbits = n;
+        if (n > old_bits) {
+            // 原来最后一个字中多余的位是 0, 新增的位需要时再置 1
+            if (value) {
+                set_range(old_bits, n);
+            }
+        } else {
+            clear_tail();
+        }
+    }
+
+    void clear() {
+        words.clear();
+        nbits = 0;
+    }
+
+    // 把 [first, last) 全部置 1 首尾两个字用掩码, 中间整字赋值
+    void set_range(size_type first, size_type last) { fill_range(first, last, true); }
+
+    // 把 [first, last) 全部置 0
+    void reset_range(size_type first, size_type last) { fill_range(first, last, false); }
+
+    void set_all() {
+        fill_words(~word_type(0));
+        clear_tail();
+    }
+
+    void reset_all() { fill_words(0); }
+
+    // 所有位取反
+    void flip_all() {
+        word_type* w = words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] = ~w[i];
+        clear_tail();
+    }
+
+    // 1 的个数 每个字一条 popcnt 指令
+    size_type count() const {
+        const word_type* w = words.data();
+        size_type res = 0;
+        for (size_type i = 0; i < words.size(); i++) res += size_type(__builtin_popcountll(w[i]));
+        return res;
+    }
+
+    bool any() const {
+        const word_type* w = words.data();
+        for (size_type i = 0; i < words.size(); i++) {
+            if (w[i]) return true;
+        }
+        return false;
+    }
+
+    bool none() const { return !any(); }
+
+    // [0, i) 中 1 的个数 O(i / 64)
+    // 需要反复查询时用 rank_select_support 建索引
+    size_type rank1(size_type i) const {
+        const word_type* w = words.data();
+        size_type res = 0;
+        for (size_type k = 0; k < i / word_bits; k++) res += size_type(__builtin_popcountll(w[k]));
+        if (i % word_bits) {
+            res += size_type(__builtin_popcountll(w[i / word_bits] & (bit(i) - 1)));
+        }
+        return res;
+    }
+
+    size_type rank0(size_type i) const { return i - rank1(i); }
+
+    // 第 k 个 (从 0 开始) 1 的位置 不存在返回 size()
+    size_type select1(size_type k) const {
+        const word_type* w = words.data();
+        for (size_type i = 0; i < words.size(); i++) {
+            size_type c = size_type(__builtin_popcountll(w[i]));
+            if (k < c) {
+                return i * word_bits + __select_in_word(w[i], k);
+            }
+            k -= c;
+        }
+        return nbits;
+    }
+
+    // 按位运算 两个位向量的长度必须相同
+    basic_bit_vector& operator&=(const basic_bit_vector& other) {
+        word_type* w = words.data();
+        const word_type* o = other.words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] &= o[i];
+        return *this;
+    }
+
+    basic_bit_vector& operator|=(const basic_bit_vector& other) {
+        word_type* w = words.data();
+        const word_type* o = other.words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] |= o[i];
+        return *this;
+    }
+
+    basic_bit_vector& operator^=(const basic_bit_vector& other) {
+        word_type* w = words.data();
+        const word_type* o = other.words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] ^= o[i];
+        return *this;
+    }
+
+    // this & ~other
+    basic_bit_vector& and_not(const basic_bit_vector& other) {
+        word_type* w = words.data();
+        const word_type* o = other.words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] &= ~o[i];
+        return *this;
+    }
+
+    // 依次对每个值为 1 的位调用 f(pos), 跳过整字为 0 的部分
+    template <typename Function>
+    void for_each_set(Function f) const {
+        const word_type* w = words.data();
+        for (size_type i = 0; i < words.size(); i++) {
+            for (word_type x = w[i]; x; x &= x - 1) {
+                f(i * word_bits + size_type(__builtin_ctzll(x)));
+            }
+        }
+    }
+
+private:
+    static size_type words_for(size_type n) { return (n + word_bits - 1) / word_bits; }
+    static word_type bit(size_type i) { return word_type(1) << (i % word_bits); }
+
+    // 低 n 位为 1 的掩码 (n < 64)
+    static word_type low_mask(size_type n) { return (word_type(1) << n) - 1; }
+
+    void fill_words(word_type value) {
+        word_type* w = words.data();
+        for (size_type i = 0; i < words.size(); i++) w[i] = value;
+    }
+
+    // 保持最后一个字中超出 size() 的位为 0
+    void clear_tail() {
+        if (nbits % word_bits) {
+            words.data()[nbits / word_bits] &= low_mask(nbits % word_bits);
+        }
+    }
+
+    void fill_range(size_type first, size_type last, bool value) {
+        if (first >= last) {
+            return;
+        }
+        word_type* w = words.data();
+        size_type fw = first / word_bits;
+        size_type lw = (last - 1) / word_bits;
+        // first 所在字中 first 及以上的位
+        word_type head = ~low_mask(first % word_bits);
+        // last - 1 所在字中 last - 1 及以下的位
+        word_type tail = last % word_bits ? low_mask(last % word_bits) : ~word_type(0);
+
+        if (fw == lw) {
+            word_type m = head & tail;
+            w[fw] = value ? (w[fw] | m) : (w[fw] & ~m);
+            return;
+        }
+
+        w[fw] = value ? (w[fw] | head) : (w[fw] & ~head);
+        const word_type fill = value ? ~word_type(0) : 0;
+        for (size_type i = fw + 1; i < lw; i++) w[i] = fill;
+        w[lw] = value ? (w[lw] | tail) : (w[lw] & ~tail);
+    }
+
+    vector<word_type, Alloc> words;
+    size_type nbits;  // 位数
+};
+
+using bit_vector = basic_bit_vector<>;
+
+// 常数时间 rank, 对数时间 select 的索引
+// 每 512 位 (8 个字, 一个 cache line) 记录一次之前 1 的累计个数
+// rank 查一次累计值, 再数最多 8 个字; select 先在累计值上二分, 再在块内逐字查找
+// 索引只对建立时的内容有效, 位向量修改后需要重新建立
+template <typename Alloc = __default_alloc_template<false, 0>>
+class rank_select_support {
+public:
+    using size_type = size_t;
+    using word_type = uint64_t;
+
+    enum { block_words = 8, block_bits = block_words * 64 };
+
+    explicit rank_select_support(const basic_bit_vector<Alloc>& bv) : bv(bv), total(0) { build(); }
+
+    rank_select_support(const rank_select_support&) = delete;
+    rank_select_support& operator=(const rank_select_support&) = delete;
+
+    // 重新建立索引
+    void build() {
+        const word_type* w = bv.data();
+        const size_type n = bv.num_words();
+        blocks.clear();
+        blocks.reserve(n / block_words + 1);
+
+        size_type sum = 0;
+        for (size_type i = 0; i < n; i++) {
+            if (i % block_words == 0) {
+                blocks.push_back(sum);
+            }
+            sum += size_type(__builtin_popcountll(w[i]));
+        }
+        total = sum;
+    }
+
+    // [0, i) 中 1 的个数
+    size_type rank1(size_type i) const {
+        const word_type* w = bv.data();
+        const size_type wi = i / 64;
+        const size_type b = wi / block_words;
+        if (b >= blocks.size()) {
+            return total;
+        }
+        size_type res = blocks.data()[b];
+        for (size_type k = b * block_words; k < wi; k++) res += size_type(__builtin_popcountll(w[k]));
+        if (i % 64) {
+            res += size_type(__builtin_popcountll(w[wi] & ((word_type(1) << (i % 64)) - 1)));
+        }
+        return res;
+    }
+
+    size_type rank0(size_type i) const { return i - rank1(i); }
+
+    // 第 k 个 (从 0 开始) 1 的位置 不存在返回 size()
+    size_type select1(size_type k) const {
+        if (k >= total) {
+            return bv.size();
+        }
+        // 最后一个累计值不超过 k 的块
+        const size_type* first = blocks.data();
+        size_type lo = 0, hi = blocks.size();
+        while (hi - lo > 1) {
+            size_type mid = (lo + hi) / 2;
+            if (first[mid] <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        k -= first[lo];
+        const word_type* w = bv.data();
+        for (size_type i = lo * block_words;; i++) {
+            size_type c = size_type(__builtin_popcountll(w[i]));
+            if (k < c) {
+                return i * 64 + __select_in_word(w[i], k);
+            }
+            k -= c;
+        }
+    }
+
+private:
+    const basic_bit_vector<Alloc>& bv;
+    vector<size_type, Alloc> blocks;  // blocks[b] = 第 b 块之前 1 的个数
+    size_type total;                  // 1 的总数
+};
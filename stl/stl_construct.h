@@ -42,7 +42,7 @@ inline void __destroy_aux(ForwardIterator first, ForwardIterator last, __false_t
         // &取这个对象的地址
         // destory(first) 直接将迭代器first本身传递给destory函数
         // 这意味着, 传递给destory的参数是一个迭代器, 不是一个对象指针。
-        destory(&*first);
+        destroy(&*first);
     }
 }
 
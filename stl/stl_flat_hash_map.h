@@ -0,0 +1,600 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "stl_alloc.h"
+#include "type_traits.h"
+
+// 开放寻址的扁平哈希表 (SwissTable 的做法)
+//
+// 元素直接存放在一块连续的槽位 (slot) 数组里, 没有链表结点, 查找不需要追指针
+// 每个槽位对应一个控制字节 (control byte):
+//   空       1000 0000  (kEmpty)
+//   已删除   1111 1110  (kDeleted) 墓碑, 查找时要跳过继续往后找
+//   有元素   0xxx xxxx  哈希值的低 7 位 (H2)
+// 控制字节按组 (group) 探测, 一组 16 个 (SSE2) 或 8 个 (无 SSE2),
+// 一条 SIMD 指令就能比较一整组的 H2, 只有 H2 相同的槽位才需要真正比较 key
+//
+// 容量是组大小的整数倍 且是 2 的幂, 探测总是从组的边界开始, 组不会跨越数组末尾
+// 查找遇到含有空槽位的组就可以停止, 因为插入时不会越过一个还有空位的组
+
+enum : signed char {
+    __hash_ctrl_empty = -128,  // 0x80
+    __hash_ctrl_deleted = -2   // 0xFE
+};
+
+// 控制字节匹配结果 每个匹配的槽位对应一个 bit
+// SSE2 版本每个槽位 1 bit (shift = 0), 无 SSE2 版本每个槽位 8 bit 只用最高位 (shift = 3)
+template <int shift>
+class __hash_bitmask {
+public:
+    explicit __hash_bitmask(uint64_t mask) : mask(mask) {}
+
+    explicit operator bool() const { return mask != 0; }
+
+    // 最低的匹配槽位在组内的下标
+    size_t lowest() const { return size_t(__builtin_ctzll(mask)) >> shift; }
+
+    // 去掉最低的匹配槽位
+    void clear_lowest() { mask &= mask - 1; }
+
+private:
+    uint64_t mask;
+};
+
+#ifdef __SSE2__
+
+struct __hash_group {
+    enum { width = 16 };
+    using bitmask = __hash_bitmask<0>;
+
+    explicit __hash_group(const signed char* pos) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+    // 控制字节等于 h2 的槽位
+    bitmask match(signed char h2) const {
+        return bitmask(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl))));
+    }
+
+    bitmask match_empty() const { return match(__hash_ctrl_empty); }
+
+    // 空和已删除的最高位都是 1, 直接取每个字节的最高位
+    bitmask match_empty_or_deleted() const { return bitmask(uint32_t(_mm_movemask_epi8(ctrl))); }
+
+    bitmask match_full() const { return bitmask(~uint32_t(_mm_movemask_epi8(ctrl)) & 0xFFFF); }
+
+    __m128i ctrl;
+};
+
+#else
+
+// 没有 SSE2 时一次处理 8 个控制字节 (一个 64 位字)
+struct __hash_group {
+    enum { width = 8 };
+    using bitmask = __hash_bitmask<3>;
+
+    static constexpr uint64_t lsbs = 0x0101010101010101ULL;
+    static constexpr uint64_t msbs = 0x8080808080808080ULL;
+
+    explicit __hash_group(const signed char* pos) { memcpy(&ctrl, pos, sizeof(ctrl)); }
+
+    // 找出等于 h2 的字节 (经典的 "字中找零字节" 技巧)
+    // 可能有假阳性, 但之后总要比较 key, 不影响正确性
+    bitmask match(signed char h2) const {
+        uint64_t x = ctrl ^ (lsbs * uint8_t(h2));
+        return bitmask((x - lsbs) & ~x & msbs);
+    }
+
+    // 空 1000 0000 最高位是 1 且第 1 位是 0, 已删除 1111 1110 第 1 位是 1
+    bitmask match_empty() const { return bitmask(ctrl & (~ctrl << 6) & msbs); }
+
+    bitmask match_empty_or_deleted() const { return bitmask(ctrl & msbs); }
+
+    bitmask match_full() const { return bitmask(~ctrl & msbs); }
+
+    uint64_t ctrl;
+};
+
+#endif
+
+// 哈希函数和比较函数都有 is_transparent 时, 允许用与 key_type 不同的类型查找 (异构查找)
+// 例如用 const char* 或 string_view 查找 string 为 key 的表, 不需要构造临时 string
+template <typename F, typename = void>
+struct __is_transparent : std::false_type {};
+
+template <typename F>
+struct __is_transparent<F, std::void_t<typename F::is_transparent>> : std::true_type {};
+
+// 查找函数的参数类型 支持异构查找时是调用者传入的类型 K, 否则是 key_type
+// 写成成员别名模板, 这样 find(const key_arg<K>&) 中的 K 仍然可以被推导
+template <bool transparent>
+struct __hash_key_arg {
+    template <typename K, typename Key>
+    using type = Key;
+};
+
+template <>
+struct __hash_key_arg<true> {
+    template <typename K, typename Key>
+    using type = K;
+};
+
+// 迭代器 Value 为 value_type 或 const value_type
+template <typename Value>
+class __flat_hash_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::remove_const<Value>::type;
+    using difference_type = ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    __flat_hash_iterator() : ctrl(nullptr), slot(nullptr), ctrl_end(nullptr) {}
+
+    __flat_hash_iterator(const signed char* ctrl, Value* slot, const signed char* ctrl_end)
+        : ctrl(ctrl), slot(slot), ctrl_end(ctrl_end) {}
+
+    // 允许 iterator 转换成 const_iterator
+    template <typename V, typename = typename std::enable_if<std::is_same<const V, Value>::value>::type>
+    __flat_hash_iterator(const __flat_hash_iterator<V>& other)
+        : ctrl(other.ctrl), slot(other.slot), ctrl_end(other.ctrl_end) {}
+
+    reference operator*() const { return *slot; }
+    pointer operator->() const { return slot; }
+
+    __flat_hash_iterator& operator++() {
+        ctrl++;
+        slot++;
+        skip_empty();
+        return *this;
+    }
+
+    __flat_hash_iterator operator++(int) {
+        __flat_hash_iterator tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    bool operator==(const __flat_hash_iterator& other) const { return ctrl == other.ctrl; }
+    bool operator!=(const __flat_hash_iterator& other) const { return ctrl != other.ctrl; }
+
+    // 跳过空槽位和已删除的槽位, 停在下一个有元素的槽位或末尾
+    void skip_empty() {
+        while (ctrl != ctrl_end && *ctrl < 0) {
+            ctrl++;
+            slot++;
+        }
+    }
+
+    const signed char* ctrl;
+    Value* slot;
+    const signed char* ctrl_end;
+};
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>,
+          typename Alloc = __default_alloc_template<false, 0>>
+class flat_hash_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using iterator = __flat_hash_iterator<value_type>;
+    using const_iterator = __flat_hash_iterator<const value_type>;
+
+private:
+    using data_allocator = simple_alloc<char, Alloc>;
+    using group = __hash_group;
+
+    // 支持异构查找时接受任意类型 K, 否则只接受 key_type
+    template <typename K>
+    using key_arg = typename __hash_key_arg<__is_transparent<Hash>::value &&
+                                            __is_transparent<KeyEqual>::value>::template type<K, key_type>;
+
+    // pair<const Key, T> 的 key 和 value 都可平凡搬移时, 扩容直接 memcpy 槽位
+    using relocatable = typename __and_type<typename __is_trivially_relocatable<Key>::type,
+                                            typename __is_trivially_relocatable<T>::type>::type;
+
+    using trivial_destructor = typename __and_type<typename __type_traits<Key>::has_trivial_destructor,
+                                                   typename __type_traits<T>::has_trivial_destructor>::type;
+
+    enum { min_capacity = group::width };
+
+public:
+    flat_hash_map() : flat_hash_map(0) {}
+
+    explicit flat_hash_map(size_type n, const hasher& hf = hasher(), const key_equal& eql = key_equal())
+        : hash_fn(hf),
+          equals(eql),
+          ctrl(nullptr),
+          slots(nullptr),
+          block(nullptr),
+          block_bytes(0),
+          cap(0),
+          num_elements(0),
+          growth_left(0) {
+        reserve(n);
+    }
+
+    flat_hash_map(const flat_hash_map& other) : flat_hash_map(0, other.hash_fn, other.equals) {
+        reserve(other.size());
+        for (const_iterator it = other.begin(); it != other.end(); ++it) {
+            insert(*it);
+        }
+    }
+
+    flat_hash_map& operator=(const flat_hash_map& other) {
+        if (this != &other) {
+            flat_hash_map tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    // 移动时直接接管控制字节和槽位 原对象回到 cap == 0 的空表状态, 之后仍可插入
+    flat_hash_map(flat_hash_map&& other) noexcept
+        : hash_fn(std::move(other.hash_fn)),
+          equals(std::move(other.equals)),
+          ctrl(other.ctrl),
+          slots(other.slots),
+          block(other.block),
+          block_bytes(other.block_bytes),
+          cap(other.cap),
+          num_elements(other.num_elements),
+          growth_left(other.growth_left) {
+        other.ctrl = nullptr;
+        other.slots = nullptr;
+        other.block = nullptr;
+        other.block_bytes = 0;
+        other.cap = 0;
+        other.num_elements = 0;
+        other.growth_left = 0;
+    }
+
+    flat_hash_map& operator=(flat_hash_map&& other) noexcept {
+        if (this != &other) {
+            flat_hash_map tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    ~flat_hash_map() {
+        destroy_slots();
+        deallocate();
+    }
+
+    void swap(flat_hash_map& other) {
+        std::swap(hash_fn, other.hash_fn);
+        std::swap(equals, other.equals);
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(block, other.block);
+        std::swap(block_bytes, other.block_bytes);
+        std::swap(cap, other.cap);
+        std::swap(num_elements, other.num_elements);
+        std::swap(growth_left, other.growth_left);
+    }
+
+    iterator begin() {
+        iterator it(ctrl, slots, ctrl + cap);
+        it.skip_empty();
+        return it;
+    }
+    iterator end() { return iterator(ctrl + cap, slots + cap, ctrl + cap); }
+
+    const_iterator begin() const { return const_cast<flat_hash_map*>(this)->begin(); }
+    const_iterator end() const { return const_cast<flat_hash_map*>(this)->end(); }
+
+    size_type size() const { return num_elements; }
+    bool empty() const { return num_elements == 0; }
+
+    hasher hash_function() const { return hash_fn; }
+    key_equal key_eq() const { return equals; }
+
+    // 槽位总数
+    size_type bucket_count() const { return cap; }
+
+    float load_factor() const { return cap == 0 ? 0.0f : float(num_elements) / float(cap); }
+
+    // 预留至少能放下 n 个元素的空间, 之后插入 n 个元素不会再扩容
+    void reserve(size_type n) {
+        if (n > num_elements + growth_left) {
+            rehash(capacity_for(n));
+        }
+    }
+
+    template <typename K = key_type>
+    iterator find(const key_arg<K>& key) {
+        size_type i = find_index(key);
+        return i == npos ? end() : iterator_at(i);
+    }
+
+    template <typename K = key_type>
+    const_iterator find(const key_arg<K>& key) const {
+        return const_cast<flat_hash_map*>(this)->find(key);
+    }
+
+    template <typename K = key_type>
+    bool contains(const key_arg<K>& key) const {
+        return find_index(key) != npos;
+    }
+
+    template <typename K = key_type>
+    size_type count(const key_arg<K>& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    T& at(const key_type& key) {
+        size_type i = find_index(key);
+        if (i == npos) {
+            throw std::out_of_range("flat_hash_map::at");
+        }
+        return slots[i].second;
+    }
+
+    const T& at(const key_type& key) const { return const_cast<flat_hash_map*>(this)->at(key); }
+
+    // key 不存在时插入 T()
+    T& operator[](const key_type& key) { return try_emplace(key).first->second; }
+
+    std::pair<iterator, bool> insert(const value_type& x) { return try_emplace(x.first, x.second); }
+
+    // key 不存在时用 args 构造 value, 存在时什么也不做
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+        const size_t hash = hash_of(key);
+        size_type i = find_index(key, hash);
+        if (i != npos) {
+            return std::pair<iterator, bool>(iterator_at(i), false);
+        }
+
+        i = prepare_insert(hash);
+        new (slots + i) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+        // 构造成功后才标记为有元素 并占用增长额度, 构造抛出异常时表保持不变
+        // 复用墓碑不占用增长额度, 占用空槽位才需要
+        if (ctrl[i] == __hash_ctrl_empty) {
+            growth_left--;
+        }
+        set_ctrl(i, h2(hash));
+        num_elements++;
+        return std::pair<iterator, bool>(iterator_at(i), true);
+    }
+
+    template <typename K = key_type>
+    size_type erase(const key_arg<K>& key) {
+        size_type i = find_index(key);
+        if (i == npos) {
+            return 0;
+        }
+        erase_at(i);
+        return 1;
+    }
+
+    // 返回下一个元素的迭代器
+    iterator erase(iterator pos) {
+        erase_at(size_type(pos.ctrl - ctrl));
+        ++pos;
+        return pos;
+    }
+
+    // 清空元素 保留空间
+    void clear() {
+        destroy_slots();
+        if (cap) {
+            memset(ctrl, __hash_ctrl_empty, cap);
+        }
+        num_elements = 0;
+        growth_left = max_load(cap);
+    }
+
+private:
+    static constexpr size_type npos = size_type(-1);
+
+    // 混合哈希值, std::hash<int> 之类的恒等哈希低位分布很差
+    static size_t mix(size_t h) {
+        uint64_t m = uint64_t(h) * 0x9E3779B97F4A7C15ULL;
+        return size_t(m ^ (m >> 32));
+    }
+
+    template <typename K>
+    size_t hash_of(const K& key) const {
+        return mix(hash_fn(key));
+    }
+
+    // 低 7 位存进控制字节, 其余位决定起始组
+    static signed char h2(size_t hash) { return static_cast<signed char>(hash & 0x7F); }
+    static size_t h1(size_t hash) { return hash >> 7; }
+
+    // 负载因子上限 7/8
+    static size_type max_load(size_type capacity) { return capacity - capacity / 8; }
+
+    // 放下 n 个元素需要的容量 (2 的幂, 至少一组)
+    static size_type capacity_for(size_type n) {
+        size_type c = min_capacity;
+        while (max_load(c) < n) c *= 2;
+        return c;
+    }
+
+    iterator iterator_at(size_type i) { return iterator(ctrl + i, slots + i, ctrl + cap); }
+
+    void set_ctrl(size_type i, signed char c) { ctrl[i] = c; }
+
+    // 按组做二次探测: 第 k 次探测 起始组 + k(k+1)/2
+    // 组数是 2 的幂, 三角数序列会遍历所有组
+    template <typename K>
+    size_type find_index(const K& key) const {
+        return cap == 0 ? npos : find_index(key, hash_of(key));
+    }
+
+    template <typename K>
+    size_type find_index(const K& key, size_t hash) const {
+        if (cap == 0) {
+            return npos;
+        }
+        const size_type group_mask = cap / group::width - 1;
+        size_type g = h1(hash) & group_mask;
+        for (size_type step = 1;; step++) {
+            const size_type base = g * group::width;
+            group grp(ctrl + base);
+            for (typename group::bitmask m = grp.match(h2(hash)); m; m.clear_lowest()) {
+                size_type i = base + m.lowest();
+                if (equals(slots[i].first, key)) {
+                    return i;
+                }
+            }
+            // 这一组还有空位, 插入时不会越过它, key 一定不在表里
+            if (grp.match_empty()) {
+                return npos;
+            }
+            g = (g + step) & group_mask;
+        }
+    }
+
+    // 找一个可以放新元素的槽位 (调用前已确认 key 不存在)
+    // 只负责在需要时扩容, 增长额度由调用者在元素构造成功后扣除
+    size_type prepare_insert(size_t hash) {
+        // 第一次插入时才分配空间
+        if (cap == 0) {
+            rehash_and_grow();
+        }
+        size_type i = find_insert_slot(hash);
+        // 复用墓碑不占用增长额度, 占用空槽位才需要
+        if (growth_left == 0 && ctrl[i] != __hash_ctrl_deleted) {
+            rehash_and_grow();
+            i = find_insert_slot(hash);
+        }
+        return i;
+    }
+
+    // 探测序列上第一个空或已删除的槽位
+    size_type find_insert_slot(size_t hash) const {
+        const size_type group_mask = cap / group::width - 1;
+        size_type g = h1(hash) & group_mask;
+        for (size_type step = 1;; step++) {
+            const size_type base = g * group::width;
+            typename group::bitmask m = group(ctrl + base).match_empty_or_deleted();
+            if (m) {
+                return base + m.lowest();
+            }
+            g = (g + step) & group_mask;
+        }
+    }
+
+    void erase_at(size_type i) {
+        slots[i].~value_type();
+        num_elements--;
+        // 所在的组还有空位时, 没有探测序列会越过这一组, 直接置为空即可
+        // 否则必须留下墓碑, 保证后面的元素还能被找到
+        if (group(ctrl + i / group::width * group::width).match_empty()) {
+            set_ctrl(i, __hash_ctrl_empty);
+            growth_left++;
+        } else {
+            set_ctrl(i, __hash_ctrl_deleted);
+        }
+    }
+
+    // 增长额度用完时: 墓碑很多就原容量重建 (清理墓碑), 否则容量翻倍
+    void rehash_and_grow() {
+        if (cap != 0 && num_elements <= max_load(cap) / 2) {
+            rehash(cap);
+        } else {
+            rehash(cap == 0 ? size_type(min_capacity) : cap * 2);
+        }
+    }
+
+    // 重新分配 new_cap 个槽位 把所有元素搬过去
+    void rehash(size_type new_cap) {
+        signed char* old_ctrl = ctrl;
+        value_type* old_slots = slots;
+        char* old_block = block;
+        size_type old_block_bytes = block_bytes;
+        size_type old_cap = cap;
+
+        allocate(new_cap);
+
+        for (size_type i = 0; i < old_cap; i++) {
+            if (old_ctrl[i] >= 0) {
+                const size_t hash = hash_of(old_slots[i].first);
+                size_type j = find_insert_slot(hash);
+                relocate(slots + j, old_slots + i, relocatable());
+                set_ctrl(j, h2(hash));
+            }
+        }
+        growth_left = max_load(cap) - num_elements;
+
+        if (old_block) {
+            data_allocator::deallocate(old_block, old_block_bytes);
+        }
+    }
+
+    // 可平凡搬移 直接按字节拷贝, 旧位置不需要析构
+    static void relocate(value_type* dst, value_type* src, __true_type) {
+        memcpy(static_cast<void*>(dst), static_cast<const void*>(src), sizeof(value_type));
+    }
+
+    static void relocate(value_type* dst, value_type* src, __false_type) {
+        new (dst) value_type(std::move(*src));
+        src->~value_type();
+    }
+
+    // 控制字节和槽位放在同一块内存里: [ctrl * cap | 对齐填充 | slots * cap]
+    void allocate(size_type new_cap) {
+        const size_type align = alignof(value_type) > 16 ? alignof(value_type) : 16;
+        const size_type ctrl_bytes = (new_cap + alignof(value_type) - 1) / alignof(value_type) * alignof(value_type);
+        const size_type bytes = align - 1 + ctrl_bytes + new_cap * sizeof(value_type);
+
+        char* p = data_allocator::allocate(bytes);
+        char* base = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~uintptr_t(align - 1));
+
+        block = p;
+        block_bytes = bytes;
+        ctrl = reinterpret_cast<signed char*>(base);
+        slots = reinterpret_cast<value_type*>(base + ctrl_bytes);
+        cap = new_cap;
+        memset(ctrl, __hash_ctrl_empty, cap);
+    }
+
+    void deallocate() {
+        if (block) {
+            data_allocator::deallocate(block, block_bytes);
+        }
+    }
+
+    void destroy_slots() { destroy_slots(trivial_destructor()); }
+
+    void destroy_slots(__true_type) {}
+
+    void destroy_slots(__false_type) {
+        for (size_type i = 0; i < cap; i++) {
+            if (ctrl[i] >= 0) {
+                slots[i].~value_type();
+            }
+        }
+    }
+
+    hasher hash_fn;         // 哈希函数对象 构造时传入, 不在每次调用时临时构造
+    key_equal equals;       // key 比较函数对象
+    signed char* ctrl;      // 控制字节数组
+    value_type* slots;      // 槽位数组
+    char* block;            // simple_alloc 分配的整块内存 (未对齐)
+    size_type block_bytes;  // 整块内存的大小
+    size_type cap;          // 槽位个数 组大小的整数倍且是 2 的幂
+    size_type num_elements; // 元素个数
+    size_type growth_left;  // 还能占用多少个空槽位 到 0 就要扩容或清理墓碑
+};
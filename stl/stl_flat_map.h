@@ -0,0 +1,373 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "stl_construct.h"
+#include "stl_uninitialized.h"
+#include "stl_vector.h"
+
+// 有序扁平容器 flat_set / flat_map
+//
+// 元素按 key 排好序存放在 vector 的连续空间里 (flat_map 的 key 和 value 各用一个 vector),
+// 查找是在连续数组上二分, 相比红黑树没有结点分配和指针追踪, cache 命中率高
+// 适合 "构建一次, 查找很多次" 的只读查找表
+//
+// 单个元素的 insert/erase 需要搬移插入点之后的所有元素, 是 O(n) 的
+// 批量数据应该用区间构造 (O(n log n)) 或区间 insert (一次归并, O(n + m log m))
+
+// 无分支二分查找 返回第一个不小于 key 的位置 (同 std::lower_bound)
+// 循环体里的条件会被编译成 cmov, 没有分支预测失败
+// 每轮 len 减半, 答案始终在 [first, first + len] 中
+template <typename T, typename K, typename Compare>
+inline const T* __flat_lower_bound(const T* first, size_t len, const K& key, Compare comp) {
+    if (len == 0) {
+        return first;
+    }
+    while (len > 1) {
+        size_t half = len / 2;
+        first = comp(first[half - 1], key) ? first + half : first;
+        len -= half;
+    }
+    return first + (comp(*first, key) ? 1 : 0);
+}
+
+template <typename Key, typename Compare = std::less<Key>, typename Alloc = __default_alloc_template<false, 0>>
+class flat_set {
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using key_compare = Compare;
+    using size_type = size_t;
+    using const_iterator = const Key*;
+
+    enum : size_t { npos = size_t(-1) };
+
+    flat_set() = default;
+
+    // 批量构建: 拷贝后排序去重, O(n log n)
+    template <typename InputIterator>
+    flat_set(InputIterator first, InputIterator last) {
+        insert(first, last);
+    }
+
+    // 底层 vector 不能拷贝
+    flat_set(const flat_set&) = delete;
+    flat_set& operator=(const flat_set&) = delete;
+
+    const_iterator begin() const { return keys.data(); }
+    const_iterator end() const { return keys.data() + keys.size(); }
+
+    size_type size() const { return keys.size(); }
+    bool empty() const { return keys.empty(); }
+    void clear() { keys.clear(); }
+    void reserve(size_type n) { keys.reserve(n); }
+
+    const Key& operator[](size_type i) const { return keys.data()[i]; }
+
+    // 第一个不小于 key 的元素的下标
+    size_type lower_bound(const Key& key) const {
+        return size_type(__flat_lower_bound(keys.data(), keys.size(), key, comp) - keys.data());
+    }
+
+    // key 所在的下标 不存在返回 npos
+    size_type index_of(const Key& key) const {
+        size_type i = lower_bound(key);
+        return i != size() && !comp(key, keys.data()[i]) ? i : size_type(npos);
+    }
+
+    bool contains(const Key& key) const { return index_of(key) != npos; }
+    size_type count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+    // 插入单个元素 O(n) 已存在返回 false
+    bool insert(const Key& key) {
+        size_type i = lower_bound(key);
+        if (i != size() && !comp(key, keys.data()[i])) {
+            return false;
+        }
+        keys.insert(keys.begin() + i, key);
+        return true;
+    }
+
+    // 批量插入: 新元素排序去重后, 与原有元素从后往前归并一次
+    // 原有元素只搬移一次, 而不是每插入一个就搬移一次尾部
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        vector<Key, Alloc> batch;
+        for (; first != last; ++first) {
+            batch.push_back(*first);
+        }
+        if (batch.empty()) {
+            return;
+        }
+
+        // 稳定排序 key 相同时保留先出现的那个, 与逐个 insert 的结果一致
+        std::stable_sort(batch.begin(), batch.end(), comp);
+        Key* batch_end = unique_sorted(batch.begin(), batch.end());
+        const size_type m = size_type(batch_end - batch.begin());
+
+        if (keys.empty()) {
+            keys.reserve(m);
+            for (size_type j = 0; j < m; j++) {
+                keys.push_back(batch[j]);
+            }
+            return;
+        }
+
+        // 先数出真正需要新增的个数 (已存在的 key 不插入), 只扩容一次
+        const size_type old_size = keys.size();
+        const size_type add = count_new(batch.begin(), m);
+        if (add == 0) {
+            return;
+        }
+        keys.resize(old_size + add);
+
+        // 从后往前归并 写入位置总在读取位置之后, 不会覆盖还没读的元素
+        Key* k = keys.data();
+        ptrdiff_t i = ptrdiff_t(old_size) - 1;
+        ptrdiff_t j = ptrdiff_t(m) - 1;
+        ptrdiff_t out = ptrdiff_t(old_size + add) - 1;
+        while (j >= 0) {
+            if (i >= 0 && comp(batch[j], k[i])) {
+                k[out--] = k[i--];
+            } else if (i >= 0 && !comp(k[i], batch[j])) {
+                j--;  // 已存在 跳过
+            } else {
+                k[out--] = batch[j--];
+            }
+        }
+    }
+
+    size_type erase(const Key& key) {
+        size_type i = index_of(key);
+        if (i == npos) {
+            return 0;
+        }
+        keys.erase(keys.begin() + i);
+        return 1;
+    }
+
+private:
+    // 去掉有序区间中相邻的重复元素 保留第一个
+    Key* unique_sorted(Key* first, Key* last) {
+        if (first == last) {
+            return last;
+        }
+        Key* res = first;
+        while (++first != last) {
+            if (comp(*res, *first)) {
+                *++res = *first;
+            }
+        }
+        return ++res;
+    }
+
+    // 有序的 batch[0, m) 中有多少个 key 不在容器里 (双指针归并计数)
+    size_type count_new(const Key* batch, size_type m) const {
+        const Key* k = keys.data();
+        const size_type n = keys.size();
+        size_type i = 0, add = 0;
+        for (size_type j = 0; j < m; j++) {
+            while (i < n && comp(k[i], batch[j])) i++;
+            if (i == n || comp(batch[j], k[i])) add++;
+        }
+        return add;
+    }
+
+    vector<Key, Alloc> keys;
+    Compare comp;
+};
+
+template <typename Key, typename T, typename Compare = std::less<Key>,
+          typename Alloc = __default_alloc_template<false, 0>>
+class flat_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_compare = Compare;
+    using size_type = size_t;
+
+    enum : size_t { npos = size_t(-1) };
+
+    flat_map() = default;
+
+    // 批量构建 区间元素是 pair<Key, T> (或者有 first second 成员的类型)
+    template <typename InputIterator>
+    flat_map(InputIterator first, InputIterator last) {
+        insert(first, last);
+    }
+
+    flat_map(const flat_map&) = delete;
+    flat_map& operator=(const flat_map&) = delete;
+
+    size_type size() const { return keys.size(); }
+    bool empty() const { return keys.empty(); }
+
+    void clear() {
+        keys.clear();
+        values.clear();
+    }
+
+    void reserve(size_type n) {
+        keys.reserve(n);
+        values.reserve(n);
+    }
+
+    // 按下标访问 第 i 小的 key 和它的 value
+    const Key& key_at(size_type i) const { return keys.data()[i]; }
+    T& value_at(size_type i) { return values.data()[i]; }
+    const T& value_at(size_type i) const { return values.data()[i]; }
+
+    // 有序的 key 数组和对应的 value 数组, 可以直接扫描
+    const Key* key_data() const { return keys.data(); }
+    T* value_data() { return values.data(); }
+
+    size_type lower_bound(const Key& key) const {
+        return size_type(__flat_lower_bound(keys.data(), keys.size(), key, comp) - keys.data());
+    }
+
+    size_type index_of(const Key& key) const {
+        size_type i = lower_bound(key);
+        return i != size() && !comp(key, keys.data()[i]) ? i : size_type(npos);
+    }
+
+    // 返回 value 的指针 不存在返回 nullptr
+    T* find(const Key& key) {
+        size_type i = index_of(key);
+        return i == npos ? nullptr : values.data() + i;
+    }
+
+    const T* find(const Key& key) const { return const_cast<flat_map*>(this)->find(key); }
+
+    bool contains(const Key& key) const { return index_of(key) != npos; }
+    size_type count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+    T& at(const Key& key) {
+        T* p = find(key);
+        if (p == nullptr) {
+            throw std::out_of_range("flat_map::at");
+        }
+        return *p;
+    }
+
+    const T& at(const Key& key) const { return const_cast<flat_map*>(this)->at(key); }
+
+    // key 不存在时插入 T()  O(n)
+    T& operator[](const Key& key) {
+        size_type i = lower_bound(key);
+        if (i == size() || comp(key, keys.data()[i])) {
+            keys.insert(keys.begin() + i, key);
+            values.insert(values.begin() + i, T());
+        }
+        return values.data()[i];
+    }
+
+    // 插入单个元素 O(n) 已存在返回 false, 不修改原来的 value
+    bool insert(const Key& key, const T& value) {
+        size_type i = lower_bound(key);
+        if (i != size() && !comp(key, keys.data()[i])) {
+            return false;
+        }
+        keys.insert(keys.begin() + i, key);
+        values.insert(values.begin() + i, value);
+        return true;
+    }
+
+    // 批量插入 与 flat_set::insert(first, last) 相同, 原有的 key 保留原来的 value
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        using entry = std::pair<Key, T>;
+
+        vector<entry, Alloc> batch;
+        for (; first != last; ++first) {
+            batch.push_back(entry(first->first, first->second));
+        }
+        if (batch.empty()) {
+            return;
+        }
+
+        Compare c = comp;
+        std::stable_sort(batch.begin(), batch.end(),
+                         [c](const entry& a, const entry& b) { return c(a.first, b.first); });
+        entry* batch_end = unique_sorted(batch.begin(), batch.end());
+        const size_type m = size_type(batch_end - batch.begin());
+
+        if (keys.empty()) {
+            reserve(m);
+            for (size_type j = 0; j < m; j++) {
+                keys.push_back(batch[j].first);
+                values.push_back(batch[j].second);
+            }
+            return;
+        }
+
+        const size_type old_size = keys.size();
+        const size_type add = count_new(batch.begin(), m);
+        if (add == 0) {
+            return;
+        }
+        keys.resize(old_size + add);
+        values.resize(old_size + add);
+
+        // 从后往前归并 key 和 value 同步搬移
+        Key* k = keys.data();
+        T* v = values.data();
+        ptrdiff_t i = ptrdiff_t(old_size) - 1;
+        ptrdiff_t j = ptrdiff_t(m) - 1;
+        ptrdiff_t out = ptrdiff_t(old_size + add) - 1;
+        while (j >= 0) {
+            if (i >= 0 && comp(batch[j].first, k[i])) {
+                k[out] = k[i];
+                v[out--] = v[i--];
+            } else if (i >= 0 && !comp(k[i], batch[j].first)) {
+                j--;  // 已存在 跳过
+            } else {
+                k[out] = batch[j].first;
+                v[out--] = batch[j--].second;
+            }
+        }
+    }
+
+    size_type erase(const Key& key) {
+        size_type i = index_of(key);
+        if (i == npos) {
+            return 0;
+        }
+        keys.erase(keys.begin() + i);
+        values.erase(values.begin() + i);
+        return 1;
+    }
+
+private:
+    template <typename Entry>
+    Entry* unique_sorted(Entry* first, Entry* last) {
+        if (first == last) {
+            return last;
+        }
+        Entry* res = first;
+        while (++first != last) {
+            if (comp(res->first, first->first)) {
+                *++res = *first;
+            }
+        }
+        return ++res;
+    }
+
+    template <typename Entry>
+    size_type count_new(const Entry* batch, size_type m) const {
+        const Key* k = keys.data();
+        const size_type n = keys.size();
+        size_type i = 0, add = 0;
+        for (size_type j = 0; j < m; j++) {
+            while (i < n && comp(k[i], batch[j].first)) i++;
+            if (i == n || comp(batch[j].first, k[i])) add++;
+        }
+        return add;
+    }
+
+    vector<Key, Alloc> keys;  // 有序的 key
+    vector<T, Alloc> values;  // values[i] 是 keys[i] 对应的 value
+    Compare comp;
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "stl_construct.h"
+#include "stl_uninitialized.h"
+#include "stl_vector.h"
+
+// 定宽整数向量 每个无符号整数只占 Bits 位, 紧密地排列在 64 位字中
+// 例如取值范围在 [0, 1000) 的整数用 10 位存储, 只有 vector<uint32_t> 的 1/3
+//
+// 第 i 个元素从第 i * Bits 位开始, 可能跨越两个字
+// 末尾多留一个字的填充, 读取时可以直接从任意字节位置读 8 个字节, 不会越界
+
+template <unsigned Bits, typename Alloc = __default_alloc_template<false, 0>>
+class packed_int_vector {
+    static_assert(Bits >= 1 && Bits <= 64, "packed_int_vector: Bits must be in [1, 64]");
+
+public:
+    using value_type = uint64_t;
+    using size_type = size_t;
+
+    static constexpr value_type max_value = Bits == 64 ? ~value_type(0) : (value_type(1) << Bits) - 1;
+
+    packed_int_vector() : count(0) {}
+
+    explicit packed_int_vector(size_type n, value_type value = 0) : count(0) { resize(n, value); }
+
+    packed_int_vector(const packed_int_vector&) = delete;
+    packed_int_vector& operator=(const packed_int_vector&) = delete;
+
+    size_type size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // 占用的字节数
+    size_type bytes() const { return words.size() * sizeof(uint64_t); }
+
+    value_type get(size_type i) const {
+        const size_type pos = i * Bits;
+        if (Bits <= 57) {
+            // 从 pos 所在的字节开始读 8 个字节, 位偏移最多 7, 7 + 57 <= 64 一次读取就够
+            uint64_t w;
+            memcpy(&w, byte_data() + pos / 8, sizeof(w));
+            return (w >> (pos % 8)) & max_value;
+        }
+        // 58 到 64 位可能跨越两个字
+        const uint64_t* w = words.data();
+        const size_type wi = pos / 64, off = pos % 64;
+        value_type v = w[wi] >> off;
+        if (off + Bits > 64) {
+            v |= w[wi + 1] << (64 - off);
+        }
+        return v & max_value;
+    }
+
+    value_type operator[](size_type i) const { return get(i); }
+
+    // value 超出 Bits 位的部分被截掉
+    void set(size_type i, value_type value) {
+        value &= max_value;
+        const size_type pos = i * Bits;
+        uint64_t* w = words.data();
+        const size_type wi = pos / 64, off = pos % 64;
+        w[wi] = (w[wi] & ~(max_value << off)) | (value << off);
+        if (off + Bits > 64) {
+            // 跨字的高位部分写到下一个字
+            const unsigned high = unsigned(off + Bits - 64);
+            const uint64_t high_mask = (uint64_t(1) << high) - 1;
+            w[wi + 1] = (w[wi + 1] & ~high_mask) | (value >> (64 - off));
+        }
+    }
+
+    void push_back(value_type value) {
+        if (words_for(count + 1) > words.size()) {
+            words.push_back(0);
+        }
+        count++;
+        set(count - 1, value);
+    }
+
+    void resize(size_type n, value_type value = 0) {
+        const size_type old = count;
+        words.resize(words_for(n), 0);
+        count = n;
+        for (size_type i = old; i < n; i++) set(i, value);
+        if (n < old) {
+            clear_tail();
+        }
+    }
+
+    void clear() {
+        words.clear();
+        count = 0;
+    }
+
+    // 批量解包 [first, first + n) 到 out
+    // 每个元素的读取互不依赖, 没有分支, 可以流水线执行
+    // 有 AVX2 且 Bits <= 25 时, 一次用 gather 解包 8 个元素
+    template <typename T>
+    void unpack(size_type first, size_type n, T* out) const {
+        size_type i = 0;
+#ifdef __AVX2__
+        i = unpack_avx2(first, n, out, std::integral_constant<bool, (Bits <= 25 && sizeof(T) == 4)>());
+#endif
+        for (; i < n; i++) out[i] = T(get(first + i));
+    }
+
+    // 从 in 批量打包 n 个元素到 [first, first + n)
+    template <typename T>
+    void pack(size_type first, size_type n, const T* in) {
+        for (size_type i = 0; i < n; i++) set(first + i, value_type(in[i]));
+    }
+
+private:
+    // n 个元素需要的字数 加一个填充字
+    static size_type words_for(size_type n) { return (n * Bits + 63) / 64 + 1; }
+
+    const unsigned char* byte_data() const { return reinterpret_cast<const unsigned char*>(words.data()); }
+
+    // 超出 size() 的位清零, 之后 push_back 不用关心旧数据
+    void clear_tail() {
+        const size_type used = count * Bits;
+        uint64_t* w = words.data();
+        if (used % 64) {
+            w[used / 64] &= (uint64_t(1) << (used % 64)) - 1;
+        }
+        for (size_type i = (used + 63) / 64; i < words.size(); i++) w[i] = 0;
+    }
+
+#ifdef __AVX2__
+    template <typename T>
+    size_type unpack_avx2(size_type, size_type, T*, std::false_type) const {
+        return 0;
+    }
+
+    // 8 个元素的位位置 pos = (first + i) * Bits
+    // 按字节偏移 pos / 8 各 gather 4 个字节, 再按 pos % 8 右移, 最后掩码
+    // Bits <= 25 时 7 + 25 <= 32, 4 个字节一定能装下一个元素
+    template <typename T>
+    size_type unpack_avx2(size_type first, size_type n, T* out, std::true_type) const {
+        const size_type max_start = (size_t(1) << 31) / Bits;  // 字节偏移要放进 int32
+        if (first + n > max_start) {
+            return 0;
+        }
+
+        const int* base = reinterpret_cast<const int*>(byte_data());
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i step = _mm256_set1_epi32(int(Bits));
+        const __m256i mask = _mm256_set1_epi32(int(max_value));
+        const __m256i seven = _mm256_set1_epi32(7);
+
+        size_type i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i pos = _mm256_set1_epi32(int((first + i) * Bits));
+            pos = _mm256_add_epi32(pos, _mm256_mullo_epi32(lane, step));
+            __m256i byte_off = _mm256_srli_epi32(pos, 3);
+            __m256i shift = _mm256_and_si256(pos, seven);
+            __m256i v = _mm256_i32gather_epi32(base, byte_off, 1);
+            v = _mm256_and_si256(_mm256_srlv_epi32(v, shift), mask);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+        return i;
+    }
+#endif
+
+    vector<uint64_t, Alloc> words;
+    size_type count;  // 元素个数
+};
@@ -0,0 +1,336 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+#include "stl_alloc.h"
+#include "stl_construct.h"
+#include "stl_uninitialized.h"
+
+// 结构体数组 (array of structs)  vector<Record>:   a b c | a b c | a b c ...
+// 数组结构体 (struct of arrays) soa_vector<A, B, C>: a a a ... | b b b ... | c c c ...
+//
+// 热循环只访问一两个字段时, vector<Record> 每次载入的 cache line 里大部分是用不到的其他字段,
+// soa_vector 把每个字段存在各自连续的数组 (列) 里, 扫描一列只会载入这一列的数据,
+// 并且每一列都按 64 字节 (cache line) 对齐, 方便 SIMD 向量化
+//
+// 所有列放在同一块内存里, 由 simple_alloc 一次分配, 扩容时所有列一起重新分配
+
+template <typename Alloc, typename... Fields>
+class basic_soa_vector {
+    static_assert(sizeof...(Fields) > 0, "soa_vector needs at least one field");
+
+public:
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    // 第 I 个字段的类型
+    template <size_t I>
+    using field_type = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+    enum { column_align = 64 };  // 每一列的起始地址按 cache line 对齐
+
+    // 一列数据的视图 [first, first + count) 连续存放
+    // 可以直接交给 SIMD 代码或者标准算法使用
+    template <typename T>
+    class column_span {
+    public:
+        using value_type = T;
+        using iterator = T*;
+
+        column_span(T* first, size_type count) : first(first), count(count) {}
+
+        iterator begin() const { return first; }
+        iterator end() const { return first + count; }
+        T* data() const { return first; }
+        size_type size() const { return count; }
+        bool empty() const { return count == 0; }
+        T& operator[](size_type n) const { return first[n]; }
+
+    private:
+        T* first;
+        size_type count;
+    };
+
+    // 行代理 用 row.get<I>() 访问第 n 行的第 I 个字段
+    // 只保存容器指针和下标, 不拷贝数据, 容器扩容后仍然有效
+    class reference {
+    public:
+        reference(basic_soa_vector* owner, size_type n) : owner(owner), n(n) {}
+
+        template <size_t I>
+        field_type<I>& get() const {
+            return std::get<I>(owner->columns)[n];
+        }
+
+        size_type index() const { return n; }
+
+    private:
+        basic_soa_vector* owner;
+        size_type n;
+    };
+
+    class const_reference {
+    public:
+        const_reference(const basic_soa_vector* owner, size_type n) : owner(owner), n(n) {}
+
+        template <size_t I>
+        const field_type<I>& get() const {
+            return std::get<I>(owner->columns)[n];
+        }
+
+        size_type index() const { return n; }
+
+    private:
+        const basic_soa_vector* owner;
+        size_type n;
+    };
+
+    basic_soa_vector() : block(nullptr), block_bytes(0), count(0), cap(0) {}
+
+    explicit basic_soa_vector(size_type n) : basic_soa_vector() { resize(n); }
+
+    // 禁止拷贝 每一列都要单独拷贝, 需要时显式地逐行 push_back
+    basic_soa_vector(const basic_soa_vector&) = delete;
+    basic_soa_vector& operator=(const basic_soa_vector&) = delete;
+
+    // 移动只交换整块内存 被移动的对象变成空容器
+    basic_soa_vector(basic_soa_vector&& x) noexcept
+        : block(x.block), block_bytes(x.block_bytes), columns(x.columns), count(x.count), cap(x.cap) {
+        x.reset();
+    }
+
+    basic_soa_vector& operator=(basic_soa_vector&& x) noexcept {
+        if (this != &x) {
+            destroy_columns(0, count, index_sequence());
+            deallocate();
+            block = x.block;
+            block_bytes = x.block_bytes;
+            columns = x.columns;
+            count = x.count;
+            cap = x.cap;
+            x.reset();
+        }
+        return *this;
+    }
+
+    ~basic_soa_vector() {
+        destroy_columns(0, count, index_sequence());
+        deallocate();
+    }
+
+    size_type size() const { return count; }
+    size_type capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+
+    reference operator[](size_type n) { return reference(this, n); }
+    const_reference operator[](size_type n) const { return const_reference(this, n); }
+
+    reference front() { return reference(this, 0); }
+    reference back() { return reference(this, count - 1); }
+
+    // 第 I 列
+    template <size_t I>
+    column_span<field_type<I>> column() {
+        return column_span<field_type<I>>(std::get<I>(columns), count);
+    }
+
+    template <size_t I>
+    column_span<const field_type<I>> column() const {
+        return column_span<const field_type<I>>(std::get<I>(columns), count);
+    }
+
+    // 在尾部加入一行 每个参数对应一个字段
+    void push_back(const Fields&... xs) {
+        if (count != cap) {
+            construct_row(columns, count, index_sequence(), xs...);
+        } else {
+            // xs 可能引用本容器中的元素 (例如 v.push_back(v.column<0>()[0], ...)),
+            // 和 vector::insert_aux 一样, 先在新空间里构造新行, 再释放旧空间
+            const size_type new_cap = cap != 0 ? 2 * cap : 1;
+            storage s = allocate_copy(new_cap, index_sequence());
+            try {
+                construct_row(s.columns, count, index_sequence(), xs...);
+            } catch (...) {
+                destroy_columns(s.columns, 0, count, index_sequence());
+                data_allocator::deallocate(s.block, s.bytes);
+                throw;
+            }
+            adopt(s, new_cap);
+        }
+        count++;
+    }
+
+    void pop_back() {
+        count--;
+        destroy_columns(count, count + 1, index_sequence());
+    }
+
+    // 保证容量至少为 n, 所有列一次重新分配
+    void reserve(size_type n) {
+        if (n > cap) {
+            reallocate(n);
+        }
+    }
+
+    // 改变行数 新增的行用默认值填充
+    void resize(size_type new_size) {
+        if (new_size < count) {
+            destroy_columns(new_size, count, index_sequence());
+            count = new_size;
+            return;
+        }
+        if (new_size > cap) {
+            reallocate(std::max(new_size, 2 * cap));
+        }
+        fill_columns(count, new_size, index_sequence());
+        count = new_size;
+    }
+
+    void clear() {
+        destroy_columns(0, count, index_sequence());
+        count = 0;
+    }
+
+private:
+    using data_allocator = simple_alloc<char, Alloc>;
+    using index_sequence = std::index_sequence_for<Fields...>;
+
+    // 上调至 column_align 的倍数
+    static size_type round_up(size_type bytes) { return (bytes + column_align - 1) & ~size_type(column_align - 1); }
+
+    // 容量为 n 时每一列相对于对齐后起始地址的偏移, 以及所需的总字节数
+    static size_type layout(size_type n, size_type* offsets) {
+        const size_type sizes[] = {sizeof(Fields)...};
+        size_type off = 0;
+        for (size_type i = 0; i < sizeof...(Fields); i++) {
+            offsets[i] = off;
+            off = round_up(off + n * sizes[i]);
+        }
+        return off;
+    }
+
+    void deallocate() {
+        if (block) {
+            data_allocator::deallocate(block, block_bytes);
+        }
+    }
+
+    // 不释放内存, 直接变成空容器 (内存已经交给了别的对象)
+    void reset() {
+        block = nullptr;
+        block_bytes = 0;
+        columns = std::tuple<Fields*...>();
+        count = 0;
+        cap = 0;
+    }
+
+    // 新分配的一块内存和其中各列的起始地址
+    struct storage {
+        char* block;
+        size_type bytes;
+        std::tuple<Fields*...> columns;
+    };
+
+    template <size_t... Is>
+    static void construct_row(const std::tuple<Fields*...>& cols, size_type n, std::index_sequence<Is...>,
+                              const Fields&... xs) {
+        // 按列依次构造 某一列构造抛出异常时, 把这一行已经构造好的列析构掉
+        size_type done = 0;
+        try {
+            ((::construct(std::get<Is>(cols) + n, xs), done++), ...);
+        } catch (...) {
+            ((Is < done ? ::destroy(std::get<Is>(cols) + n) : void()), ...);
+            throw;
+        }
+    }
+
+    // 在 [first, last) 上默认构造一列 抛出异常时析构这一列已经构造好的元素
+    template <typename T>
+    static void fill_column(T* first, T* last) {
+        T* cur = first;
+        try {
+            for (; cur != last; ++cur) ::construct(cur, T());
+        } catch (...) {
+            ::destroy(first, cur);
+            throw;
+        }
+    }
+
+    template <size_t... Is>
+    void fill_columns(size_type first, size_type last, std::index_sequence<Is...>) {
+        // 和 construct_row 一样, 某一列抛出异常时把前面已经填好的列析构掉, 行数不变
+        size_type done = 0;
+        try {
+            ((fill_column(std::get<Is>(columns) + first, std::get<Is>(columns) + last), done++), ...);
+        } catch (...) {
+            ((Is < done ? ::destroy(std::get<Is>(columns) + first, std::get<Is>(columns) + last) : void()), ...);
+            throw;
+        }
+    }
+
+    template <size_t... Is>
+    static void destroy_columns(const std::tuple<Fields*...>& cols, size_type first, size_type last,
+                                std::index_sequence<Is...>) {
+        (::destroy(std::get<Is>(cols) + first, std::get<Is>(cols) + last), ...);
+    }
+
+    void destroy_columns(size_type first, size_type last, index_sequence seq) {
+        destroy_columns(columns, first, last, seq);
+    }
+
+    // 所有列一起搬到新分配的一块内存上
+    void reallocate(size_type new_cap) {
+        storage s = allocate_copy(new_cap, index_sequence());
+        adopt(s, new_cap);
+    }
+
+    // 分配容量为 new_cap 的新空间, 把现有的行拷贝过去, 旧空间不变
+    template <size_t... Is>
+    storage allocate_copy(size_type new_cap, std::index_sequence<Is...>) {
+        size_type offsets[sizeof...(Fields)];
+        // 多分配 column_align - 1 字节, 用来把起始地址上调对齐
+        // simple_alloc 只保证 8 或 16 字节对齐
+        const size_type new_bytes = layout(new_cap, offsets) + column_align - 1;
+
+        char* new_block = data_allocator::allocate(new_bytes);
+        char* base = reinterpret_cast<char*>(round_up(reinterpret_cast<size_type>(new_block)));
+        std::tuple<Fields*...> new_columns(reinterpret_cast<Fields*>(base + offsets[Is])...);
+
+        // 逐列拷贝 POD 类型由 uninitialized_copy 退化成 memmove
+        size_type done = 0;
+        try {
+            ((::uninitialized_copy(std::get<Is>(columns), std::get<Is>(columns) + count, std::get<Is>(new_columns)),
+              done++),
+             ...);
+        } catch (...) {
+            ((Is < done ? ::destroy(std::get<Is>(new_columns), std::get<Is>(new_columns) + count) : void()), ...);
+            data_allocator::deallocate(new_block, new_bytes);
+            throw;
+        }
+        return storage{new_block, new_bytes, new_columns};
+    }
+
+    // 析构并释放旧空间, 换成 allocate_copy 得到的新空间
+    void adopt(const storage& s, size_type new_cap) {
+        destroy_columns(0, count, index_sequence());
+        deallocate();
+
+        block = s.block;
+        block_bytes = s.bytes;
+        columns = s.columns;
+        cap = new_cap;
+    }
+
+    char* block;               // simple_alloc 分配的整块内存 (未对齐)
+    size_type block_bytes;     // 整块内存的大小, 释放时使用
+    std::tuple<Fields*...> columns;  // 每一列的起始地址 (已对齐)
+    size_type count;           // 行数
+    size_type cap;             // 每一列的容量
+};
+
+// 默认使用第二级配置器
+template <typename... Fields>
+using soa_vector = basic_soa_vector<__default_alloc_template<false, 0>, Fields...>;
+
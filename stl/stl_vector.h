@@ -72,7 +72,7 @@ public:
 
     ~vector() {
         // 先析构掉内存上的对象
-        destroy(start, finish);
+        ::destroy(start, finish);
         // 然后把内存归还给free list 或者 free掉
         // 这里调用的是vector的成员函数
         deallocate();
@@ -85,7 +85,7 @@ public:
     void push_back(const T& x) {
         // 还有可以用的备用空间
         if (finish != end_of_storage) {
-            construct(finish, x);  // 调用stl_construct.h中的construct全域函数
+            ::construct(finish, x);  // 调用stl_construct.h中的construct全域函数
             finish++;
         } else
             insert_aux(end(), x);
@@ -93,18 +93,64 @@ public:
 
     // 将末端元素弹出(取出) O(1)
     void pop_back() {
-        // 析构对象 但不释放内存
-        destroy(finish);  // stl_construct.h中的destroy全域函数
+        // 尾端标记往前移一格 析构对象 但不释放内存
+        --finish;
+        ::destroy(finish);  // stl_construct.h中的destroy全域函数
     }
 
     // 删除迭代器所指位置上的元素 O(n)
     iterator erase(iterator position) {
-        if (position + 1 != end()) copy(position + 1, finish, position);  // 後續元素往前搬移
+        if (position + 1 != end()) std::copy(position + 1, finish, position);  // 後續元素往前搬移
         --finish;
-        destroy(finish);
+        ::destroy(finish);
         return position;
     }
 
+    // 删除 [first, last) 上的所有元素
+    iterator erase(iterator first, iterator last) {
+        // 把 last 之后的元素往前搬到 first 开始的位置
+        iterator i = std::copy(last, finish, first);
+        // 析构掉尾部多出来的元素
+        ::destroy(i, finish);
+        finish = finish - (last - first);
+        return first;
+    }
+
+    // 在position位置上插入一个x 返回指向新元素的迭代器
+    iterator insert(iterator position, const T& x) {
+        size_type n = position - begin();
+        if (finish != end_of_storage && position == end()) {
+            ::construct(finish, x);
+            finish++;
+        } else {
+            insert_aux(position, x);
+        }
+        // insert_aux 可能重新分配了空间, 用下标重新计算位置
+        return begin() + n;
+    }
+
+    // 保证容量至少为 n 只在容量不够时重新分配一次
+    void reserve(size_type n) {
+        if (capacity() < n) {
+            const size_type old_size = size();
+            iterator new_start = data_allocator::allocate(n);
+            try {
+                ::uninitialized_copy(start, finish, new_start);
+            } catch (...) {
+                data_allocator::deallocate(new_start, n);
+                throw;
+            }
+            ::destroy(start, finish);
+            deallocate();
+            start = new_start;
+            finish = new_start + old_size;
+            end_of_storage = new_start + n;
+        }
+    }
+
+    // 底层连续数组的首地址
+    pointer data() const { return start; }
+
     // 	改变容器中可存储元素的个数
     void resize(size_type new_size, const T& x) {
         // 如果新大小比之前小 就删除末尾多余的元素
@@ -124,6 +170,11 @@ public:
 
     void insert(iterator position, size_type n, const T& x);
 
+    // 二进制读入 (stl_vector_io.h) 直接把数据读进 [start, end_of_storage) 的未初始化空间
+    // 需要访问 start finish end_of_storage, 避免先填充默认值再覆盖
+    template <typename U, typename A>
+    friend int vector_read(int fd, vector<U, A>& v);
+
 protected:
     iterator allocate_and_fill(size_type n, const T& x) {
         // 这里默认调用第二级配置器 分配空间
@@ -131,7 +182,7 @@ protected:
         // 调用 simple_alloc<value_type, Alloc> 中的 allocate
         // 然后 n * sizeof(value_type);
 
-        uninitialized_fill_n(res, n, x);
+        ::uninitialized_fill_n(res, n, x);
         // 返回的是配置空间的起始位置
         return res;
     }
@@ -142,13 +193,14 @@ template <typename T, typename Alloc>
 void vector<T, Alloc>::insert_aux(iterator position, const T& x) {
     // 还有备用空间
     if (finish != end_of_storage) {
-        // TODO
-        // construct(finish, *(finish - 1));
-        // ++finish;
-        // T x_copy = x;
-        // copy_backward(position, finish - 2, finish - 1);
-        // *position = x_copy;
-
+        // 在备用空间起始处构造一个元素, 以当前最后一个元素为初值
+        ::construct(finish, *(finish - 1));
+        ++finish;
+        // x 可能引用容器中的元素, 先拷贝一份
+        T x_copy = x;
+        // [position, finish - 2) 整体往后移一格
+        std::copy_backward(position, finish - 2, finish - 1);
+        *position = x_copy;
     } else {
         // 没有可以用的备用空间
         const size_type old_size = size();  // 记录原来的大小
@@ -166,27 +218,26 @@ void vector<T, Alloc>::insert_aux(iterator position, const T& x) {
         try {
             // 要在position位置插入数据， 则position前面的数据是原封不动搬到新内存区域
             // 将原来的 [start, position) 区域 拷贝到新的内存区域
-            // 这里position是原来的 end()
-            new_finish = uninitialized_copy(start, position, new_start);
+            new_finish = ::uninitialized_copy(start, position, new_start);
             // 在new_finish位置上构造新元素x
-            construct(new_finish, x);
+            ::construct(new_finish, x);
             // 尾巴后移一个
             new_finish++;
 
-            // 将原空间的备用空间内容也拷贝过来
-            // new_finish = uninitialized_copy(position, finish, new_finish);
+            // 将原来 [position, finish) 的内容接在新元素后面
+            new_finish = ::uninitialized_copy(position, finish, new_finish);
 
             // 三个点表示可以捕获任意类型的异常
         } catch (...) {
             // 析构掉
-            destroy(new_start, new_finish);
+            ::destroy(new_start, new_finish);
             // 释放空间
             data_allocator::deallocate(new_start, len);
             throw;
         }
 
         // 析构原来的空间
-        destroy(begin(), end());
+        ::destroy(begin(), end());
         // 释放原来的空间
         deallocate();
 
@@ -201,7 +252,7 @@ void vector<T, Alloc>::insert_aux(iterator position, const T& x) {
 template <class T, class Alloc>
 void vector<T, Alloc>::insert(iterator position, size_type n, const T& x) {
     if (0 != n) {
-        // 备用空间大于新增的个数 TODO
+        // 备用空间大于新增的个数
         if (size_type(end_of_storage - finish) >= n) {
             T x_copy = x;
 
@@ -211,16 +262,17 @@ void vector<T, Alloc>::insert(iterator position, size_type n, const T& x) {
 
             // 大于要插入的个数 n
             if (elems_after > n) {
-                // uninitialized_copy(finish - n, finish, finish);
-                // finish += n;
-                // copy_backward(position, old_finish - n, old_finish);
-                // fill(position, position + n, x_copy);
-
+                // 末尾 n 个元素搬到未初始化的备用空间
+                ::uninitialized_copy(finish - n, finish, finish);
+                finish += n;
+                // 剩下的 [position, old_finish - n) 往后移 n 格
+                std::copy_backward(position, old_finish - n, old_finish);
+                std::fill(position, position + n, x_copy);
             } else {
                 // 先填充finish
-                uninitialized_fill_n(finish, n - elems_after, x_copy);
+                ::uninitialized_fill_n(finish, n - elems_after, x_copy);
                 finish += n - elems_after;
-                uninitialized_copy(position, old_finish, finish);
+                ::uninitialized_copy(position, old_finish, finish);
                 finish += elems_after;
                 std::fill(position, old_finish, x_copy);
             }
@@ -238,18 +290,18 @@ void vector<T, Alloc>::insert(iterator position, size_type n, const T& x) {
 
             try {
                 // 将原来的 [start, position) 区域 拷贝到新的内存区域
-                new_finish = uninitialized_copy(start, position, new_start);
+                new_finish = ::uninitialized_copy(start, position, new_start);
                 // 从new_finish开始填充n个值为x的元素
-                new_finish = uninitialized_fill_n(new_finish, n, x);
+                new_finish = ::uninitialized_fill_n(new_finish, n, x);
                 // 将[positon, finish) 移动到n个被插入元素的后面
-                new_finish = uninitialized_copy(position, finish, new_finish);
+                new_finish = ::uninitialized_copy(position, finish, new_finish);
             } catch (...) {
-                destroy(new_start, new_finish);
+                ::destroy(new_start, new_finish);
                 data_allocator::deallocate(new_start, len);
                 throw;
             }
 
-            destroy(start, finish);
+            ::destroy(start, finish);
             deallocate();
 
             start = new_start;
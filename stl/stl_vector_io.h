@@ -0,0 +1,473 @@
+#pragma once
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "stl_construct.h"
+#include "stl_uninitialized.h"
+#include "stl_vector.h"
+
+// vector<T> 的二进制序列化格式 (只支持 trivially copyable 的 POD 记录)
+//
+// 文件布局:
+// [ 64 字节文件头 | count * sizeof(T) 字节的元素数据 ]
+// 文件头固定 64 字节, mmap 返回的地址按页对齐, 所以数据区按 64 字节对齐,
+// 可以直接把映射出来的内存当成 T 数组使用 (零拷贝)
+
+enum {
+    __VECTOR_IO_VERSION = 1,                // 格式版本号, 不兼容的改动要加一
+    __VECTOR_IO_HEADER_SIZE = 64,           // 文件头大小, 同时也是数据区的对齐
+    __VECTOR_IO_ENDIAN_TAG = 0x01020304,    // 用来检测字节序是否一致
+    __VECTOR_IO_CHUNK = 4 * 1024 * 1024     // 流式读入时每次 read 的大小, 校验和在块还在缓存里时计算
+};
+
+struct vector_file_header {
+    char magic[8];         // "CPPVEC\0\0"
+    uint32_t version;      // 格式版本
+    uint32_t header_size;  // 文件头大小 (数据区偏移)
+    uint32_t endian_tag;   // 写入端的字节序标记
+    uint32_t elem_size;    // sizeof(T)
+    uint32_t elem_align;   // alignof(T)
+    uint32_t reserved0;
+    uint64_t count;     // 元素个数
+    uint64_t checksum;  // 数据区的校验和
+    char reserved[16];  // 保留 填0
+};
+
+static_assert(sizeof(vector_file_header) == __VECTOR_IO_HEADER_SIZE, "vector_file_header must be 64 bytes");
+
+static const char __vector_io_magic[8] = {'C', 'P', 'P', 'V', 'E', 'C', 0, 0};
+
+// 数据区校验和
+// 4 路 64 位累加器, 每次处理 32 字节, 速度接近内存带宽
+// 支持分块调用 update(), 结果与一次性计算相同
+class vector_checksum {
+public:
+    vector_checksum() : length(0), pending_size(0) {
+        h[0] = PRIME1 + PRIME2;
+        h[1] = PRIME2;
+        h[2] = 0;
+        h[3] = 0 - PRIME1;
+    }
+
+    void update(const void* buf, size_t n) {
+        // 空 vector 的 buf 可能是 nullptr, 不能传给 memcpy
+        if (n == 0) return;
+        const unsigned char* p = static_cast<const unsigned char*>(buf);
+        length += n;
+
+        // 先把上一次剩下的不足 32 字节补满
+        if (pending_size != 0) {
+            size_t fill = std::min(n, size_t(32) - pending_size);
+            memcpy(pending + pending_size, p, fill);
+            pending_size += fill;
+            p += fill;
+            n -= fill;
+            if (pending_size < 32) return;
+            block(pending);
+            pending_size = 0;
+        }
+
+        for (; n >= 32; p += 32, n -= 32) block(p);
+
+        // 剩下的留到下一次 update 或 final
+        memcpy(pending, p, n);
+        pending_size = n;
+    }
+
+    uint64_t final() const {
+        uint64_t res = rotl(h[0], 1) + rotl(h[1], 7) + rotl(h[2], 12) + rotl(h[3], 18);
+        res += length;
+
+        // 尾部不足 32 字节的部分逐个 8 字节处理, 最后不足 8 字节的逐字节处理
+        size_t i = 0;
+        for (; i + 8 <= pending_size; i += 8) {
+            uint64_t w;
+            memcpy(&w, pending + i, 8);
+            res = rotl(res ^ round(0, w), 27) * PRIME1 + PRIME4;
+        }
+        for (; i < pending_size; i++) {
+            res = rotl(res ^ (pending[i] * PRIME5), 11) * PRIME1;
+        }
+
+        // 最后打散一下
+        res ^= res >> 33;
+        res *= PRIME2;
+        res ^= res >> 29;
+        res *= PRIME3;
+        res ^= res >> 32;
+        return res;
+    }
+
+private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static uint64_t round(uint64_t acc, uint64_t w) { return rotl(acc + w * PRIME2, 31) * PRIME1; }
+
+    void block(const unsigned char* p) {
+        // memcpy 读取避免未对齐访问, 编译器会优化成普通的 load
+        uint64_t w[4];
+        memcpy(w, p, 32);
+        h[0] = round(h[0], w[0]);
+        h[1] = round(h[1], w[1]);
+        h[2] = round(h[2], w[2]);
+        h[3] = round(h[3], w[3]);
+    }
+
+    uint64_t h[4];        // 4 路累加器 互不依赖 可以并行执行
+    uint64_t length;      // 已处理的总字节数
+    unsigned char pending[32];
+    size_t pending_size;  // pending 中有效的字节数
+};
+
+inline uint64_t __vector_io_checksum(const void* buf, size_t n) {
+    vector_checksum sum;
+    sum.update(buf, n);
+    return sum.final();
+}
+
+// 根据元素类型填写文件头
+template <typename T>
+inline void __vector_io_fill_header(vector_file_header& header, size_t count, uint64_t checksum) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, __vector_io_magic, sizeof(header.magic));
+    header.version = __VECTOR_IO_VERSION;
+    header.header_size = __VECTOR_IO_HEADER_SIZE;
+    header.endian_tag = __VECTOR_IO_ENDIAN_TAG;
+    header.elem_size = sizeof(T);
+    header.elem_align = alignof(T);
+    header.count = count;
+    header.checksum = checksum;
+}
+
+// 检查文件头和元素类型是否匹配
+// 不匹配时设置 errno 并返回 -1
+template <typename T>
+inline int __vector_io_check_header(const vector_file_header& header) {
+    if (memcmp(header.magic, __vector_io_magic, sizeof(header.magic)) != 0 ||
+        header.version != __VECTOR_IO_VERSION || header.header_size != __VECTOR_IO_HEADER_SIZE ||
+        header.endian_tag != __VECTOR_IO_ENDIAN_TAG) {
+        errno = EBADMSG;
+        return -1;
+    }
+    // 元素的大小和对齐必须与写入端一致
+    if (header.elem_size != sizeof(T) || header.elem_align != alignof(T)) {
+        errno = EINVAL;
+        return -1;
+    }
+    // count * sizeof(T) 不能溢出
+    if (header.count > size_t(-1) / sizeof(T)) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return 0;
+}
+
+// 读满 n 字节, 处理 EINTR 和短读
+// 读到文件末尾还不够 n 字节, 返回 -1
+inline int __vector_io_read_full(int fd, void* buf, size_t n) {
+    char* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t res = ::read(fd, p, n);
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (res == 0) {
+            errno = EIO;  // 文件被截断
+            return -1;
+        }
+        p += res;
+        n -= size_t(res);
+    }
+    return 0;
+}
+
+// 把 vector 写到 fd (文件, 管道, socket 都可以)
+// 文件头和整个 [start, finish) 连续区间用一次 writev 写出,
+// 只有短写时才会继续调用 writev 写剩下的部分
+// 成功返回 0, 失败返回 -1 并设置 errno
+template <typename T, typename Alloc>
+int vector_write(int fd, const vector<T, Alloc>& v) {
+    // 按字节原样写出, 元素必须可以直接按内存拷贝
+    static_assert(std::is_trivially_copyable<T>::value, "vector_write requires a trivially copyable type");
+
+    const size_t bytes = v.size() * sizeof(T);
+    const char* data = reinterpret_cast<const char*>(v.begin());
+
+    vector_file_header header;
+    __vector_io_fill_header<T>(header, v.size(), __vector_io_checksum(data, bytes));
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = bytes;
+
+    struct iovec* cur = iov;
+    int iovcnt = bytes != 0 ? 2 : 1;
+
+    while (iovcnt > 0) {
+        ssize_t res = ::writev(fd, cur, iovcnt);
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // 短写: 跳过已经写完的 iovec, 调整写了一半的那个
+        size_t written = size_t(res);
+        while (iovcnt > 0 && written >= cur->iov_len) {
+            written -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            cur->iov_base = static_cast<char*>(cur->iov_base) + written;
+            cur->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+// 写到文件 path, 文件已存在则截断
+template <typename T, typename Alloc>
+int vector_write(const char* path, const vector<T, Alloc>& v) {
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int res = vector_write(fd, v);
+
+    // close 失败也可能意味着数据没有写出去
+    if (::close(fd) != 0 && res == 0) {
+        res = -1;
+    }
+    return res;
+}
+
+// 从 fd 流式读入到 v 中, 原有元素被丢弃
+// 普通文件先用文件大小检查 count, 只分配一次内存 (容量足够时不分配), 数据直接 read 进 vector 的未初始化空间
+// 管道和 socket 不知道总长度, 容量随读到的数据翻倍增长, 损坏的文件头不会造成一次巨大的分配
+// 成功返回 0
+// 失败返回 -1 并设置 errno, 此时 v 为空
+// errno: EBADMSG 格式错误或校验和不符, EINVAL 元素类型不匹配, EIO 数据不完整
+template <typename T, typename Alloc>
+int vector_read(int fd, vector<T, Alloc>& v) {
+    static_assert(std::is_trivially_copyable<T>::value, "vector_read requires a trivially copyable type");
+
+    using data_allocator = typename vector<T, Alloc>::data_allocator;
+
+    // 丢弃原有元素 保留原有空间
+    ::destroy(v.start, v.finish);
+    v.finish = v.start;
+
+    vector_file_header header;
+    if (__vector_io_read_full(fd, &header, sizeof(header)) != 0 || __vector_io_check_header<T>(header) != 0) {
+        return -1;
+    }
+
+    const size_t n = size_t(header.count);
+    const size_t bytes = n * sizeof(T);
+
+    // 第一次分配的元素个数
+    size_t first_n = n;
+    struct stat st;
+    off_t pos;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (pos = lseek(fd, 0, SEEK_CUR)) >= 0) {
+        // 文件剩下的长度不够 count 个元素, 不用分配就可以报错
+        if (st.st_size < pos || uint64_t(st.st_size - pos) < bytes) {
+            errno = EIO;
+            return -1;
+        }
+    } else {
+        first_n = std::min(n, std::max(size_t(1), size_t(__VECTOR_IO_CHUNK) / sizeof(T)));
+    }
+
+    // 提示内核顺序读, 加大预读
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t left = bytes;
+    vector_checksum sum;
+
+    // 分块读入, 每块读完马上算校验和, 此时数据还在缓存里
+    while (left > 0) {
+        size_t len = std::min(left, size_t(__VECTOR_IO_CHUNK));
+        size_t done = bytes - left;
+
+        // 容量不够才重新分配, 已经读入的字节原样搬过去
+        size_t cap = size_t(v.end_of_storage - v.start);
+        if (done + len > cap * sizeof(T)) {
+            size_t new_cap = std::max(std::max(cap * 2, first_n), (done + len + sizeof(T) - 1) / sizeof(T));
+            new_cap = std::min(new_cap, n);
+            T* new_start = data_allocator::allocate(new_cap);
+            if (done != 0) {
+                memcpy(new_start, v.start, done);
+            }
+            v.deallocate();
+            v.start = v.finish = new_start;
+            v.end_of_storage = new_start + new_cap;
+        }
+
+        char* p = reinterpret_cast<char*>(v.start) + done;
+        if (__vector_io_read_full(fd, p, len) != 0) {
+            return -1;
+        }
+        sum.update(p, len);
+        left -= len;
+    }
+
+    if (sum.final() != header.checksum) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    v.finish = v.start + n;
+    return 0;
+}
+
+// 从文件 path 读入
+template <typename T, typename Alloc>
+int vector_read(const char* path, vector<T, Alloc>& v) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int res = vector_read(fd, v);
+    // 保存 vector_read 设置的 errno
+    int err = errno;
+    ::close(fd);
+    errno = err;
+    return res;
+}
+
+// 把 vector_write 写出的文件 mmap 进来, 原地当作只读的 T 数组使用
+// 不拷贝, 不分配, 页面按需由内核载入
+template <typename T>
+class vector_view {
+public:
+    using value_type = T;
+    using const_pointer = const T*;
+    using const_iterator = const T*;
+    using const_reference = const T&;
+    using size_type = size_t;
+
+    static_assert(std::is_trivially_copyable<T>::value, "vector_view requires a trivially copyable type");
+    // 数据区只保证 64 字节对齐
+    static_assert(alignof(T) <= __VECTOR_IO_HEADER_SIZE, "vector_view requires alignof(T) <= 64");
+
+    vector_view() : base(nullptr), length(0), first(nullptr), count(0) {}
+
+    ~vector_view() { close(); }
+
+    // 禁止拷贝, 映射只能有一个所有者
+    vector_view(const vector_view&) = delete;
+    vector_view& operator=(const vector_view&) = delete;
+
+    // verify 为 true 时会扫描一遍数据校验, 会把所有页面读进来
+    // 成功返回 0, 失败返回 -1 并设置 errno
+    int open(const char* path, bool verify = true) {
+        close();
+
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            return -1;
+        }
+
+        if (size_t(st.st_size) < sizeof(vector_file_header)) {
+            ::close(fd);
+            errno = EBADMSG;
+            return -1;
+        }
+
+        void* addr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        // 映射建立后 fd 就可以关掉了
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return -1;
+        }
+
+        base = addr;
+        length = size_t(st.st_size);
+
+        const vector_file_header* header = static_cast<const vector_file_header*>(base);
+        if (__vector_io_check_header<T>(*header) != 0) {
+            int err = errno;
+            close();
+            errno = err;
+            return -1;
+        }
+
+        const size_t bytes = size_t(header->count) * sizeof(T);
+        if (length - header->header_size < bytes) {
+            close();
+            errno = EIO;
+            return -1;
+        }
+
+        first = reinterpret_cast<const T*>(static_cast<const char*>(base) + header->header_size);
+        count = size_t(header->count);
+
+        // 大多数使用场景都是顺序扫描
+        madvise(base, length, MADV_SEQUENTIAL);
+
+        if (verify && __vector_io_checksum(first, bytes) != header->checksum) {
+            close();
+            errno = EBADMSG;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    void close() {
+        if (base) {
+            munmap(base, length);
+        }
+        base = nullptr;
+        length = 0;
+        first = nullptr;
+        count = 0;
+    }
+
+    bool is_open() const { return base != nullptr; }
+
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return first + count; }
+    const_pointer data() const { return first; }
+
+    size_type size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const_reference operator[](size_type n) const { return first[n]; }
+
+private:
+    void* base;        // mmap 返回的地址
+    size_t length;     // 映射的长度 (整个文件)
+    const T* first;    // 数据区起始
+    size_type count;   // 元素个数
+};
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "stl_bit_vector.h"
+#include "stl_packed_int_vector.h"
+
+// 各种位宽都和 std::vector<uint64_t> 对照
+template <unsigned Bits>
+void test_packed() {
+    const size_t n = 3000;
+    packed_int_vector<Bits> p;
+    std::vector<uint64_t> ref;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t x = ((uint64_t(rand()) << 32) ^ uint64_t(rand())) & packed_int_vector<Bits>::max_value;
+        p.push_back(x);
+        ref.push_back(x);
+    }
+    for (size_t i = 0; i < n; i++) {
+        assert(p[i] == ref[i]);
+    }
+
+    // 改写一个元素不影响相邻的元素 (包括跨字的元素)
+    for (size_t i = 0; i < n; i += 7) {
+        p.set(i, packed_int_vector<Bits>::max_value);
+        ref[i] = packed_int_vector<Bits>::max_value;
+    }
+    for (size_t i = 0; i < n; i++) {
+        assert(p.get(i) == ref[i]);
+    }
+
+    uint32_t out32[100];
+    uint64_t out64[100];
+    p.unpack(1001, 100, out64);
+    for (size_t i = 0; i < 100; i++) {
+        assert(out64[i] == ref[1001 + i]);
+    }
+    if (Bits <= 32) {
+        p.unpack(13, 100, out32);
+        for (size_t i = 0; i < 100; i++) {
+            assert(out32[i] == ref[13 + i]);
+        }
+    }
+    p.pack(0, 100, out64);
+    for (size_t i = 0; i < 100; i++) {
+        assert(p.get(i) == ref[1001 + i]);
+    }
+
+    // 缩小后再扩大 新元素是填充值
+    p.resize(10);
+    p.resize(20, 1);
+    assert(p.size() == 20 && p.get(9) == ref[1010] && p.get(10) == 1 && p.get(19) == 1);
+}
+
+int main() {
+    srand(7);
+
+    bit_vector b(1000);
+    std::vector<bool> ref(1000);
+    for (int i = 0; i < 1000; i++) {
+        if (rand() % 3 == 0) {
+            b.set(i);
+            ref[i] = true;
+        }
+    }
+    size_t ones = 0;
+    for (int i = 0; i < 1000; i++) {
+        assert(b[i] == ref[i]);
+        ones += ref[i];
+    }
+    assert(b.count() == ones && b.any());
+
+    // rank / select 与逐位统计对照, 建索引的版本结果一致
+    rank_select_support<> rs(b);
+    size_t r = 0;
+    for (size_t i = 0; i <= 1000; i++) {
+        assert(b.rank1(i) == r && rs.rank1(i) == r && rs.rank0(i) == i - r);
+        if (i < 1000 && ref[i]) {
+            assert(b.select1(r) == i && rs.select1(r) == i);
+            r++;
+        }
+    }
+    assert(b.select1(ones) == b.size() && rs.select1(ones) == b.size());
+
+    // 区间操作 跨字边界 与单字内
+    b.reset_all();
+    assert(b.none());
+    b.set_range(60, 200);
+    assert(b.count() == 140 && !b[59] && b[60] && b[199] && !b[200]);
+    b.reset_range(65, 70);
+    assert(b.count() == 135 && b[64] && !b[65] && !b[69] && b[70]);
+
+    // 整体取反不会把末尾不足一个字的多余位置 1
+    b.flip_all();
+    assert(b.count() == 1000 - 135);
+    b.set_all();
+    assert(b.count() == 1000);
+
+    bit_vector c(1000);
+    c.set_range(0, 500);
+    b &= c;
+    assert(b.count() == 500);
+    b ^= c;
+    assert(b.none());
+    b |= c;
+    b.and_not(c);
+    assert(b.none());
+
+    size_t seen = 0;
+    c.for_each_set([&](size_t i) {
+        assert(i == seen);
+        seen++;
+    });
+    assert(seen == 500);
+
+    bit_vector d;
+    for (int i = 0; i < 130; i++) d.push_back(i % 2 == 0);
+    assert(d.size() == 130 && d.count() == 65 && d[128] && !d[129]);
+    d.resize(64);
+    d.resize(130);
+    assert(d.count() == 32);
+
+    test_packed<1>();
+    test_packed<7>();
+    test_packed<10>();
+    test_packed<25>();
+    test_packed<33>();
+    test_packed<57>();
+    test_packed<63>();
+    test_packed<64>();
+
+    printf("bit_vector ok\n");
+    return 0;
+}
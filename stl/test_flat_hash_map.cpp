@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <string>
+#include <string_view>
+
+#include "stl_flat_hash_map.h"
+
+// 带状态的哈希函数 记录被调用的次数, 检查表里用的是构造时传入的那一个
+struct CountingHash {
+    using is_transparent = void;
+    int* calls;
+
+    size_t operator()(std::string_view s) const {
+        (*calls)++;
+        return std::hash<std::string_view>()(s);
+    }
+};
+
+struct TransparentEqual {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const { return a == b; }
+};
+
+// 构造时抛出异常的 value
+struct Throwing {
+    explicit Throwing(bool fail) {
+        if (fail) throw 1;
+    }
+};
+
+int main() {
+    flat_hash_map<int, int> m;
+    for (int i = 0; i < 10000; i++) {
+        m[i] = i * 2;
+    }
+    assert(m.size() == 10000 && m.load_factor() <= 0.875f);
+    for (int i = 0; i < 10000; i++) {
+        assert(m.at(i) == i * 2);
+    }
+    assert(!m.insert({5, 0}).second && m[5] == 10);
+    assert(m.find(10000) == m.end());
+
+    for (int i = 0; i < 10000; i += 2) {
+        assert(m.erase(i) == 1);
+    }
+    assert(m.size() == 5000 && !m.contains(0) && m.contains(1));
+    size_t n = 0;
+    for (auto& kv : m) {
+        assert(kv.first % 2 == 1 && kv.second == kv.first * 2);
+        n++;
+    }
+    assert(n == 5000);
+
+    bool thrown = false;
+    try {
+        m.at(-1);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    flat_hash_map<int, int> copy(m);
+    assert(copy.size() == 5000 && copy[9999] == 19998);
+
+    // 移动直接接管槽位, 原对象变成空表并且可以继续使用
+    const int* before = &copy.at(9999);
+    flat_hash_map<int, int> moved(std::move(copy));
+    assert(moved.size() == 5000 && &moved.at(9999) == before);
+    assert(copy.empty() && copy.bucket_count() == 0 && copy.begin() == copy.end() && !copy.contains(1));
+    copy[1] = 2;
+    assert(copy.size() == 1 && copy.at(1) == 2);
+    copy = std::move(moved);
+    assert(copy.size() == 5000 && copy[9999] == 19998 && moved.empty() && moved.find(1) == moved.end());
+
+    // 哈希函数对象在构造时传入并保存, 异构查找不构造临时 string
+    int calls = 0;
+    flat_hash_map<std::string, int, CountingHash, TransparentEqual> s(0, CountingHash{&calls});
+    s["apple"] = 1;
+    s["banana"] = 2;
+    assert(calls > 0);
+    assert(s.find("apple")->second == 1 && s.contains(std::string_view("banana")) && !s.contains("cherry"));
+    assert(s.hash_function().calls == &calls);
+
+    // value 构造失败不占用增长额度: 16 个槽位最多放 14 个元素
+    flat_hash_map<int, Throwing> t;
+    t.reserve(1);
+    assert(t.bucket_count() == 16);
+    for (int i = 0; i < 100; i++) {
+        try {
+            t.try_emplace(i, true);
+            assert(false);
+        } catch (int) {
+        }
+    }
+    assert(t.empty());
+    for (int i = 0; i < 14; i++) {
+        assert(t.try_emplace(i, false).second);
+    }
+    assert(t.size() == 14 && t.bucket_count() == 16);
+
+    printf("flat_hash_map ok\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "stl_flat_map.h"
+
+int main() {
+    srand(42);
+
+    // 随机插入 删除 与 std::set 对照
+    flat_set<int> s;
+    std::set<int> ref;
+    for (int i = 0; i < 5000; i++) {
+        int k = rand() % 2000;
+        assert(s.insert(k) == ref.insert(k).second);
+        if (i % 3 == 0) {
+            int e = rand() % 2000;
+            assert(s.erase(e) == ref.erase(e));
+        }
+    }
+    assert(s.size() == ref.size());
+    size_t i = 0;
+    for (int k : ref) {
+        assert(s[i++] == k);
+    }
+    for (int k = -10; k < 2010; k++) {
+        assert(s.contains(k) == (ref.count(k) == 1));
+        assert(s.lower_bound(k) == size_t(std::distance(ref.begin(), ref.lower_bound(k))));
+    }
+
+    // 批量插入 区间内有重复, 也有和已有元素重复的
+    int batch[] = {5000, -1, 7, 5000, 7, 3000, -1};
+    s.insert(batch, batch + 7);
+    ref.insert(batch, batch + 7);
+    assert(s.size() == ref.size());
+    i = 0;
+    for (int k : ref) {
+        assert(s[i++] == k);
+    }
+
+    // 区间构造 空容器
+    flat_set<int> empty(batch, batch);
+    assert(empty.empty() && empty.lower_bound(3) == 0 && !empty.contains(3));
+
+    // flat_map 批量插入时同一个 key 保留先出现的那个, 已有的 key 保留原来的 value
+    std::pair<std::string, int> items[] = {{"b", 2}, {"a", 1}, {"c", 3}, {"a", 100}};
+    flat_map<std::string, int> m(items, items + 4);
+    assert(m.size() == 3 && m.at("a") == 1 && m.key_at(0) == "a" && m.key_at(2) == "c");
+
+    std::pair<std::string, int> more[] = {{"d", 4}, {"b", 200}, {"0", 0}};
+    m.insert(more, more + 3);
+    assert(m.size() == 5 && m.at("b") == 2 && m.at("d") == 4 && m.key_at(0) == "0");
+    for (size_t j = 1; j < m.size(); j++) {
+        assert(m.key_at(j - 1) < m.key_at(j));
+    }
+
+    assert(!m.insert("c", 300) && m.at("c") == 3);
+    assert(m.insert("e", 5) && *m.find("e") == 5);
+    m["f"] = 6;
+    assert(m["f"] == 6 && m["g"] == 0 && m.size() == 8);
+    assert(m.erase("g") == 1 && m.erase("g") == 0 && m.find("g") == nullptr);
+
+    bool thrown = false;
+    try {
+        m.at("zzz");
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // key 和 value 两个数组始终对齐
+    std::map<std::string, int> expect = {{"0", 0}, {"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}, {"f", 6}};
+    i = 0;
+    for (auto& kv : expect) {
+        assert(m.key_data()[i] == kv.first && m.value_data()[i] == kv.second);
+        i++;
+    }
+
+    printf("flat_map ok\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "stl_soa_vector.h"
+
+// 记录存活的对象个数, 第 fail_at 次默认构造时抛出异常
+struct Counted {
+    static int live;
+    static int fail_at;
+    int x;
+    Counted() : x(0) {
+        if (--fail_at == 0) throw 1;
+        live++;
+    }
+    Counted(const Counted& c) : x(c.x) { live++; }
+    ~Counted() { live--; }
+};
+int Counted::live = 0;
+int Counted::fail_at = -1;
+
+static soa_vector<int, std::string> make(int n) {
+    soa_vector<int, std::string> v;
+    for (int i = 0; i < n; i++) v.push_back(i, std::to_string(i));
+    return v;
+}
+
+int main() {
+    soa_vector<int, double, std::string> v;
+    for (int i = 0; i < 1000; i++) {
+        v.push_back(i, i * 0.5, std::to_string(i));
+    }
+    assert(v.size() == 1000 && v.capacity() >= 1000);
+    assert(v[999].get<0>() == 999 && v[999].get<1>() == 499.5 && v[999].get<2>() == "999");
+
+    // 每一列按 cache line 对齐
+    assert(uintptr_t(v.column<0>().data()) % 64 == 0);
+    assert(uintptr_t(v.column<1>().data()) % 64 == 0);
+    assert(uintptr_t(v.column<2>().data()) % 64 == 0);
+
+    long sum = 0;
+    for (int x : v.column<0>()) {
+        sum += x;
+    }
+    assert(sum == 999 * 1000 / 2);
+
+    // 参数引用容器自己的元素, 并且这次 push_back 会触发扩容
+    soa_vector<int, double, std::string> s;
+    s.push_back(7, 1.5, std::string(100, 'x'));
+    // 容量 1 2 4 8 时各扩容一次
+    for (int i = 0; i < 10; i++) {
+        s.push_back(s[0].get<0>(), s[0].get<1>(), s[0].get<2>());
+    }
+    for (size_t i = 0; i < s.size(); i++) {
+        assert(s[i].get<0>() == 7 && s[i].get<1>() == 1.5 && s[i].get<2>() == std::string(100, 'x'));
+    }
+
+    s.pop_back();
+    assert(s.size() == 10);
+    s.resize(3);
+    assert(s.size() == 3 && s.back().get<2>().size() == 100);
+    s.resize(5);
+    assert(s.size() == 5 && s[4].get<0>() == 0 && s[4].get<2>().empty());
+    s.reserve(100);
+    assert(s.capacity() == 100 && s[0].get<0>() == 7);
+    s.clear();
+    assert(s.empty());
+
+    // resize 时某一列的默认构造抛出异常: 已经填好的列和这一列已构造的元素都被析构, 行数不变
+    {
+        soa_vector<std::string, Counted> c;
+        c.push_back("a", Counted());
+        assert(Counted::live == 1);
+        Counted::fail_at = 5;
+        bool thrown = false;
+        try {
+            c.resize(10);
+        } catch (int) {
+            thrown = true;
+        }
+        assert(thrown && c.size() == 1 && Counted::live == 1);
+        Counted::fail_at = -1;
+        c.resize(10);
+        assert(c.size() == 10 && Counted::live == 10);
+    }
+    assert(Counted::live == 0);
+
+    // 移动构造和移动赋值交出整块内存, 原对象变成空容器
+    soa_vector<int, std::string> m = make(100);
+    assert(m.size() == 100 && m[99].get<1>() == "99");
+    const int* data = m.column<0>().data();
+    soa_vector<int, std::string> n(std::move(m));
+    assert(m.empty() && m.capacity() == 0 && n.size() == 100 && n.column<0>().data() == data);
+    m.push_back(1, "1");
+    n = std::move(m);
+    assert(m.empty() && n.size() == 1 && n[0].get<1>() == "1");
+    n = make(3);
+    assert(n.size() == 3 && n[2].get<0>() == 2);
+
+    printf("soa_vector ok\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "stl_vector_io.h"
+
+struct Point {
+    int x;
+    int y;
+    double w;
+};
+
+int main() {
+    const char* path = "/tmp/test_vector_io.bin";
+
+    vector<Point> v;
+    for (int i = 0; i < 100000; i++) {
+        v.push_back(Point{i, -i, i * 0.5});
+    }
+    assert(vector_write(path, v) == 0);
+
+    // 读入到已有元素的 vector, 原有元素被丢弃
+    vector<Point> r(size_t(3), Point{1, 1, 1});
+    assert(vector_read(path, r) == 0);
+    assert(r.size() == v.size());
+    for (size_t i = 0; i < r.size(); i++) {
+        assert(r[i].x == v[i].x && r[i].y == v[i].y && r[i].w == v[i].w);
+    }
+
+    // 原地映射
+    vector_view<Point> view;
+    assert(view.open(path) == 0);
+    assert(view.size() == v.size() && view[99999].x == 99999);
+    view.close();
+
+    // 元素类型不匹配
+    vector<int> wrong;
+    assert(vector_read(path, wrong) == -1 && errno == EINVAL);
+
+    // 空 vector
+    vector<Point> empty;
+    assert(vector_write(path, empty) == 0);
+    assert(vector_read(path, r) == 0 && r.empty());
+
+    // 文件头声称的元素个数远大于文件长度: 不分配就报错
+    assert(vector_write(path, v) == 0);
+    int fd = open(path, O_RDWR);
+    vector_file_header header;
+    assert(pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)));
+    header.count = uint64_t(1) << 40;
+    assert(pwrite(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)));
+    close(fd);
+    vector<Point> big;
+    assert(vector_read(path, big) == -1 && errno == EIO && big.capacity() == 0);
+
+    // 截断的文件
+    assert(vector_write(path, v) == 0);
+    assert(truncate(path, sizeof(vector_file_header) + 100 * sizeof(Point)) == 0);
+    assert(vector_read(path, r) == -1 && errno == EIO);
+
+    // 管道不知道总长度, 按读到的数据逐步扩容
+    int fds[2];
+    assert(pipe(fds) == 0);
+    if (fork() == 0) {
+        close(fds[0]);
+        vector_write(fds[1], v);
+        _exit(0);
+    }
+    close(fds[1]);
+    vector<Point> piped;
+    assert(vector_read(fds[0], piped) == 0 && piped.size() == v.size() && piped[12345].y == -12345);
+    close(fds[0]);
+
+    unlink(path);
+    printf("vector_io ok\n");
+    return 0;
+}
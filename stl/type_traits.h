@@ -155,4 +155,24 @@ struct __type_traits<T*> {
     using is_POD_type = __true_type;
 };
 
-// 基本(内置）类型都是__true_type, 而对象都是__false_type
\ No newline at end of file
+// 基本(内置）类型都是__true_type, 而对象都是__false_type
+
+// 两个 __true_type/__false_type 的逻辑与, 用于组合多个类型的特性
+// 例如 pair<Key, T> 只有 Key 和 T 都是平凡的才是平凡的
+template <typename T1, typename T2>
+struct __and_type {
+    using type = __false_type;
+};
+
+template <>
+struct __and_type<__true_type, __true_type> {
+    using type = __true_type;
+};
+
+// 可平凡搬移 (trivially relocatable)
+// 拷贝构造和析构都是平凡的, 把对象搬到另一块内存时可以直接 memcpy, 原位置不用析构
+template <typename T>
+struct __is_trivially_relocatable {
+    using type = typename __and_type<typename __type_traits<T>::has_trivial_copy_constructor,
+                                     typename __type_traits<T>::has_trivial_destructor>::type;
+};
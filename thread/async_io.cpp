@@ -0,0 +1,313 @@
+#include "async_io.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+
+#include "futex.h"
+
+// 内核与用户态共享的队列指针 用 acquire / release 读写, 与 liburing 相同
+static unsigned loadAcquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void storeRelease(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+AsyncIO::AsyncIO(ThreadPool& pool, unsigned entries, int fallback_threads, bool try_uring)
+    : pool(pool),
+      max_inflight(entries == 0 ? 1 : entries),
+      inflight(0),
+      waiting(0),
+      stopping(false),
+      ring_fd(-1),
+      sq_ptr(MAP_FAILED),
+      cq_ptr(MAP_FAILED),
+      sqes(MAP_FAILED) {
+    pthread_mutex_init(&submit_mutex, nullptr);
+    pthread_mutex_init(&request_mutex, nullptr);
+    pthread_cond_init(&request_cond, nullptr);
+
+    if (try_uring && setupUring(max_inflight) == 0) {
+        if (pthread_create(&reap_thread, nullptr, reapFunc, this) == 0) {
+            return;
+        }
+        munmap(sqes, sqes_size);
+        if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(ring_fd);
+        ring_fd = -1;
+    }
+
+    for (int i = 0; i < (fallback_threads < 1 ? 1 : fallback_threads); i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, nullptr, workerFunc, this) == 0) {
+            io_threads.push_back(tid);
+        }
+    }
+}
+
+AsyncIO::~AsyncIO() {
+    stopping = true;
+
+    // 等所有请求完成, 它们的回调都已经交给线程池
+    waiting.fetch_add(1);
+    uint32_t n;
+    while ((n = inflight.load()) != 0) {
+        futexWait(&inflight, n);
+    }
+    waiting.fetch_sub(1);
+
+    if (ring_fd >= 0) {
+        // 完成线程可能正睡在 io_uring_enter 里, 提交一个空操作叫醒它
+        pthread_mutex_lock(&submit_mutex);
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        sq_array[index] = index;
+        storeRelease(sq_tail, tail + 1);
+        while (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) < 0 && (errno == EINTR || errno == EAGAIN)) {
+        }
+        pthread_mutex_unlock(&submit_mutex);
+        pthread_join(reap_thread, nullptr);
+
+        munmap(sqes, sqes_size);
+        if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(ring_fd);
+    } else {
+        pthread_mutex_lock(&request_mutex);
+        pthread_cond_broadcast(&request_cond);
+        pthread_mutex_unlock(&request_mutex);
+        for (size_t i = 0; i < io_threads.size(); i++) pthread_join(io_threads[i], nullptr);
+    }
+
+    pthread_mutex_destroy(&submit_mutex);
+    pthread_mutex_destroy(&request_mutex);
+    pthread_cond_destroy(&request_cond);
+}
+
+int AsyncIO::setupUring(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = int(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return -1;
+    }
+    if (!probeUring(fd)) {
+        close(fd);
+        return -1;
+    }
+
+    // 提交队列和完成队列的环, 新内核上它们在同一块映射中
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    cq_ptr = single ? sq_ptr
+                    : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && !single) munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(fd);
+        return -1;
+    }
+
+    char* sq = static_cast<char*>(sq_ptr);
+    char* cq = static_cast<char*>(cq_ptr);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    // 同时进行的请求不超过提交队列长度, 完成队列 (默认是它的两倍) 不会溢出
+    if (max_inflight > params.sq_entries) {
+        max_inflight = params.sq_entries;
+    }
+    ring_fd = fd;
+    return 0;
+}
+
+bool AsyncIO::probeUring(int fd) {
+    // 5.1 ~ 5.5 的内核有 io_uring 但没有 IORING_OP_READ / WRITE, 也没有 IORING_REGISTER_PROBE (返回 EINVAL)
+    const unsigned max_ops = 256;
+    alignas(io_uring_probe) char buf[sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op)];
+    memset(buf, 0, sizeof(buf));
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buf);
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+        return false;
+    }
+    const unsigned ops[] = {IORING_OP_READ, IORING_OP_WRITE};
+    for (unsigned i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (ops[i] > probe->last_op || ops[i] >= probe->ops_len ||
+            !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int AsyncIO::read(int fd, void* buf, size_t len, uint64_t offset, IoTask* done) {
+    done->op = IoTask::Read;
+    done->fd = fd;
+    done->buf = buf;
+    done->len = len;
+    done->offset = offset;
+    return submit(done);
+}
+
+int AsyncIO::write(int fd, const void* buf, size_t len, uint64_t offset, IoTask* done) {
+    done->op = IoTask::Write;
+    done->fd = fd;
+    done->buf = const_cast<void*>(buf);
+    done->len = len;
+    done->offset = offset;
+    return submit(done);
+}
+
+int AsyncIO::submit(IoTask* task) {
+    if (stopping) {
+        return -1;
+    }
+
+    // 占一个名额, 满了等 complete 释放
+    while (true) {
+        uint32_t n = inflight.load();
+        if (n < max_inflight) {
+            if (inflight.compare_exchange_weak(n, n + 1)) {
+                break;
+            }
+            continue;
+        }
+        waiting.fetch_add(1);
+        futexWait(&inflight, n);
+        waiting.fetch_sub(1);
+    }
+
+    if (ring_fd >= 0) {
+        return submitUring(task);
+    }
+
+    pthread_mutex_lock(&request_mutex);
+    requests.push_back(task);
+    pthread_cond_signal(&request_cond);
+    pthread_mutex_unlock(&request_mutex);
+    return 0;
+}
+
+int AsyncIO::submitUring(IoTask* task) {
+    pthread_mutex_lock(&submit_mutex);
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = task->op == IoTask::Read ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = task->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(task->buf);
+    // 一次最多读写 4GB, 和 read / write 一样可能只完成一部分
+    sqe->len = task->len > UINT_MAX ? UINT_MAX : unsigned(task->len);
+    sqe->off = task->offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(task);
+    sq_array[index] = index;
+    storeRelease(sq_tail, tail + 1);
+
+    // 没有 SQPOLL 时 io_uring_enter 返回前内核已经取走了提交的条目
+    long ret;
+    while ((ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0)) < 0 &&
+           (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+    }
+    if (ret < 1) {
+        // 内核没有取走这个条目 (只在 io_uring_enter 中取, 而提交都持有 submit_mutex), 撤回它
+        // 否则下一次提交会把它一起交给内核, 完成时 user_data 指向的任务已经还给了调用者
+        storeRelease(sq_tail, tail);
+        pthread_mutex_unlock(&submit_mutex);
+        releaseSlot();
+        return -1;
+    }
+    pthread_mutex_unlock(&submit_mutex);
+    return 0;
+}
+
+void AsyncIO::complete(IoTask* task, ssize_t result) {
+    task->result = result;
+    // 先交给线程池再释放名额, 析构函数返回时所有回调都已经提交 (或执行完)
+    // 线程池拒绝时在本线程直接执行, 回调不会丢失, CallbackTask 也会在执行后释放
+    if (pool.addTask(task) != 0) {
+        task->run();
+    }
+    releaseSlot();
+}
+
+void AsyncIO::releaseSlot() {
+    inflight.fetch_sub(1);
+    if (waiting.load() > 0) {
+        futexWake(&inflight);
+    }
+}
+
+void* AsyncIO::reapFunc(void* data) {
+    AsyncIO* io = static_cast<AsyncIO*>(data);
+    while (true) {
+        // 只有本线程修改 cq_head
+        unsigned head = *io->cq_head;
+        unsigned tail = loadAcquire(io->cq_tail);
+        if (head == tail) {
+            if (io->stopping && io->inflight.load() == 0) {
+                break;
+            }
+            // 睡眠到至少有一个完成
+            syscall(__NR_io_uring_enter, io->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            continue;
+        }
+
+        io_uring_cqe* cqe = static_cast<io_uring_cqe*>(io->cqes) + (head & *io->cq_mask);
+        IoTask* task = reinterpret_cast<IoTask*>(cqe->user_data);
+        ssize_t result = cqe->res;
+        storeRelease(io->cq_head, head + 1);
+        // user_data 为 0 的是析构时叫醒本线程的空操作
+        if (task) {
+            io->complete(task, result);
+        }
+    }
+    return nullptr;
+}
+
+void* AsyncIO::workerFunc(void* data) {
+    AsyncIO* io = static_cast<AsyncIO*>(data);
+    while (true) {
+        pthread_mutex_lock(&io->request_mutex);
+        while (io->requests.empty() && !io->stopping) {
+            pthread_cond_wait(&io->request_cond, &io->request_mutex);
+        }
+        if (io->requests.empty()) {
+            pthread_mutex_unlock(&io->request_mutex);
+            break;
+        }
+        IoTask* task = io->requests.front();
+        io->requests.pop_front();
+        pthread_mutex_unlock(&io->request_mutex);
+
+        ssize_t n = task->op == IoTask::Read ? pread(task->fd, task->buf, task->len, off_t(task->offset))
+                                             : pwrite(task->fd, task->buf, task->len, off_t(task->offset));
+        io->complete(task, n < 0 ? -errno : n);
+    }
+    return nullptr;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "block_pool.h"
+#include "thread_pool.h"
+
+// 异步文件读写
+// 任务提交读写请求后立即返回, 不占用工作线程等待磁盘; 完成后把回调任务放进线程池执行
+// 优先用 io_uring (直接用系统调用, 不依赖 liburing): 提交时写入共享的提交队列, 一个完成线程从完成队列取结果
+// 内核不支持或禁止 io_uring, 或者不支持 IORING_OP_READ / WRITE (5.6 之前) 时
+// 退回到几个专门的 I/O 线程执行阻塞的 pread / pwrite
+// (普通文件总是 "就绪" 的, epoll 对它们没有用)
+//
+//     AsyncIO io(pool);
+//     io.read(fd, buf, len, offset, [](ssize_t n) { ... });  // 回调在工作线程中执行
+
+// 读写完成后执行的任务, 请求的参数也保存在这里, 一个请求完成之前不能再次提交
+class IoTask : public Task {
+public:
+    ssize_t getResult() const { return result; }  // 读写的字节数, 失败为 -errno
+
+private:
+    friend class AsyncIO;
+    enum Op { Read, Write };
+
+    Op op;
+    int fd;
+    void* buf;
+    size_t len;
+    uint64_t offset;
+    ssize_t result;
+};
+
+class AsyncIO {
+public:
+    // entries 为 io_uring 的队列长度, 也是同时进行的请求数上限
+    // io_uring 不可用 (或 try_uring 为 false) 时启动 fallback_threads 个 I/O 线程
+    explicit AsyncIO(ThreadPool& pool, unsigned entries = 256, int fallback_threads = 4, bool try_uring = true);
+    // 等待所有请求完成 (回调已经提交给线程池) 后返回
+    // 正在读写的请求不算线程池的任务, ThreadPool::waitIdle 不等它们
+    ~AsyncIO();
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    // 从 fd 的 offset 处读最多 len 字节到 buf, 完成后把 done 提交给线程池
+    // 线程池拒绝 (Fail 策略或已经停止) 时 done 在完成线程中直接执行
+    // 同时进行的请求达到上限时等待; 成功返回 0, 已经关闭或提交失败返回 -1, 这时 done 不会被执行
+    int read(int fd, void* buf, size_t len, uint64_t offset, IoTask* done);
+    int write(int fd, const void* buf, size_t len, uint64_t offset, IoTask* done);
+
+    // 完成后在工作线程中调用 f(result), 任务节点从 BlockPool 分配, 执行后释放
+    // 返回 -1 时 f 不会被调用
+    template <typename F, typename = std::enable_if_t<!std::is_convertible<F, IoTask*>::value>>
+    int read(int fd, void* buf, size_t len, uint64_t offset, F&& f) {
+        CallbackTask<std::decay_t<F>>* task = CallbackTask<std::decay_t<F>>::create(std::forward<F>(f));
+        if (read(fd, buf, len, offset, task) != 0) {
+            task->destroy();
+            return -1;
+        }
+        return 0;
+    }
+
+    template <typename F, typename = std::enable_if_t<!std::is_convertible<F, IoTask*>::value>>
+    int write(int fd, const void* buf, size_t len, uint64_t offset, F&& f) {
+        CallbackTask<std::decay_t<F>>* task = CallbackTask<std::decay_t<F>>::create(std::forward<F>(f));
+        if (write(fd, buf, len, offset, task) != 0) {
+            task->destroy();
+            return -1;
+        }
+        return 0;
+    }
+
+    bool usingUring() const { return ring_fd >= 0; }
+
+private:
+    template <typename F>
+    class CallbackTask : public IoTask {
+    public:
+        template <typename G>
+        static CallbackTask* create(G&& g) {
+            return new (blockAllocate(sizeof(CallbackTask), alignof(CallbackTask))) CallbackTask(std::forward<G>(g));
+        }
+
+        void run() override {
+            func(getResult());
+            destroy();
+        }
+
+        void destroy() {
+            this->~CallbackTask();
+            blockDeallocate(this, sizeof(CallbackTask), alignof(CallbackTask));
+        }
+
+    protected:
+        // 线程池停止时丢弃: 不调用回调, 只释放节点 (回调捕获的对象随之析构)
+        void onCancel() override { destroy(); }
+
+        bool ownedByPool() const override { return true; }
+
+    private:
+        template <typename G>
+        explicit CallbackTask(G&& g) : func(std::forward<G>(g)) {}
+
+        F func;
+    };
+
+    int submit(IoTask* task);
+    void complete(IoTask* task, ssize_t result);  // 提交回调任务, 释放一个请求名额
+    void releaseSlot();                           // 释放一个请求名额, 唤醒等待的提交者
+    int setupUring(unsigned entries);             // 失败返回 -1
+    static bool probeUring(int fd);               // 内核是否支持 IORING_OP_READ / WRITE
+    int submitUring(IoTask* task);
+    static void* reapFunc(void* data);    // io_uring 的完成线程
+    static void* workerFunc(void* data);  // 退回方案的 I/O 线程
+
+    ThreadPool& pool;
+    unsigned max_inflight;
+    std::atomic<uint32_t> inflight;   // 正在进行的请求数, 提交者在上面等待名额
+    std::atomic<int> waiting;         // 等待名额的提交者数
+    std::atomic<bool> stopping;
+
+    // io_uring
+    int ring_fd;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    void* sqes;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* cqes;
+    pthread_mutex_t submit_mutex;  // 多个线程同时提交时保护提交队列
+    pthread_t reap_thread;
+
+    // 退回方案
+    std::deque<IoTask*> requests;  // 由 request_mutex 保护
+    pthread_mutex_t request_mutex;
+    pthread_cond_t request_cond;
+    std::vector<pthread_t> io_threads;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <cstddef>
+#include <new>
+
+// 定长内存块池 给线程池的任务节点用, 避免每个任务都调用一次 new / delete
+//
+// 每个线程有一个本地缓存, 分配和释放通常只操作本地链表, 不加锁
+// 本地缓存空了从全局链表批量取一批, 太多了批量还给全局链表
+// 任务通常在提交线程分配, 在工作线程释放, 批量归还保证内存能回到提交线程
+// 和 SGI 的内存池一样, 从系统申请的大块内存不会还给系统
+template <size_t Size>
+class BlockPool {
+    static_assert(Size >= sizeof(void*) && Size % alignof(std::max_align_t) == 0, "BlockPool: bad block size");
+
+public:
+    static void* allocate() {
+        Cache& c = cache;
+        if (c.head == nullptr) {
+            refill(c);
+        }
+        Block* b = c.head;
+        c.head = b->next;
+        c.count--;
+        return b;
+    }
+
+    static void deallocate(void* p) {
+        Cache& c = cache;
+        Block* b = static_cast<Block*>(p);
+        b->next = c.head;
+        c.head = b;
+        if (++c.count > cache_max) {
+            flush(c, batch);
+        }
+    }
+
+private:
+    enum { cache_max = 64, batch = 32, chunk_blocks = 64 };
+
+    struct Block {
+        Block* next;
+    };
+
+    struct Cache {
+        Block* head = nullptr;
+        int count = 0;
+        // 线程退出时把缓存的块全部还给全局链表
+        ~Cache() { flush(*this, count); }
+    };
+
+    // 从全局链表取最多 batch 块, 全局链表也空了就向系统申请一大块
+    static void refill(Cache& c) {
+        pthread_mutex_lock(&mutex);
+        for (int i = 0; i < batch && global; i++) {
+            Block* b = global;
+            global = b->next;
+            b->next = c.head;
+            c.head = b;
+            c.count++;
+        }
+        pthread_mutex_unlock(&mutex);
+        if (c.head) {
+            return;
+        }
+
+        char* chunk = static_cast<char*>(::operator new(Size * chunk_blocks));
+        for (int i = chunk_blocks - 1; i >= 0; i--) {
+            Block* b = reinterpret_cast<Block*>(chunk + i * Size);
+            b->next = c.head;
+            c.head = b;
+        }
+        c.count += chunk_blocks;
+    }
+
+    // 把本地缓存中的 n 块还给全局链表
+    static void flush(Cache& c, int n) {
+        if (n == 0) {
+            return;
+        }
+        Block* first = c.head;
+        Block* last = first;
+        for (int i = 1; i < n; i++) last = last->next;
+        c.head = last->next;
+        c.count -= n;
+
+        pthread_mutex_lock(&mutex);
+        last->next = global;
+        global = first;
+        pthread_mutex_unlock(&mutex);
+    }
+
+    static thread_local Cache cache;
+    static Block* global;
+    static pthread_mutex_t mutex;
+};
+
+template <size_t Size>
+thread_local typename BlockPool<Size>::Cache BlockPool<Size>::cache;
+
+template <size_t Size>
+typename BlockPool<Size>::Block* BlockPool<Size>::global = nullptr;
+
+template <size_t Size>
+pthread_mutex_t BlockPool<Size>::mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 按 64, 128, 256, 512 字节分级, 更大的直接用 operator new
+// n 和 align 通常是编译期常量, 分支会被优化掉
+// 块只保证 max_align_t 对齐, 对齐要求更高的类型 (例如 alignas(64) 的可调用对象) 用带对齐的 operator new
+// 释放时必须传入和分配时相同的 n 和 align
+inline void* blockAllocate(size_t n, size_t align = alignof(std::max_align_t)) {
+    if (align > alignof(std::max_align_t)) return ::operator new(n, std::align_val_t(align));
+    if (n <= 64) return BlockPool<64>::allocate();
+    if (n <= 128) return BlockPool<128>::allocate();
+    if (n <= 256) return BlockPool<256>::allocate();
+    if (n <= 512) return BlockPool<512>::allocate();
+    return ::operator new(n);
+}
+
+inline void blockDeallocate(void* p, size_t n, size_t align = alignof(std::max_align_t)) {
+    if (align > alignof(std::max_align_t)) return ::operator delete(p, std::align_val_t(align));
+    if (n <= 64) return BlockPool<64>::deallocate(p);
+    if (n <= 128) return BlockPool<128>::deallocate(p);
+    if (n <= 256) return BlockPool<256>::deallocate(p);
+    if (n <= 512) return BlockPool<512>::deallocate(p);
+    ::operator delete(p);
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+// 需要 C++20 (-std=c++20)
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <utility>
+
+#include "block_pool.h"
+#include "futex.h"
+#include "thread_pool.h"
+
+// 在 ThreadPool 上运行的协程
+//
+//     CoTask<int> work(ThreadPool& pool) {
+//         co_await schedule(pool);         // 之后的代码在工作线程中执行
+//         int a = co_await load(pool);     // 等待另一个协程, 不占用工作线程
+//         co_return a + 1;
+//     }
+//     int r = syncWait(work(pool));
+//
+// CoTask 是惰性的, 被 co_await (或 syncWait) 时才开始执行
+// 子协程结束时直接切换到等待它的协程 (对称转移), 不经过线程池, 也不会加深调用栈
+// 协程帧从 BlockPool 分配, 它可以在一个线程分配, 在另一个线程释放
+
+// 把协程恢复放进线程池执行的任务
+class ResumeTask : public Task {
+public:
+    ResumeTask(std::coroutine_handle<> handle, bool* cancelled) : handle(handle), cancelled(cancelled) {}
+
+    void run() override {
+        std::coroutine_handle<> h = handle;
+        this->~ResumeTask();
+        blockDeallocate(this, sizeof(ResumeTask), alignof(ResumeTask));
+        h.resume();
+    }
+
+protected:
+    // 挂起的协程不能就这样丢掉, 否则等待它的协程和 syncWait 永远等不到结果
+    // 在当前线程恢复它, co_await schedule 抛出 TaskCancelled
+    void onCancel() override {
+        *cancelled = true;
+        run();
+    }
+
+    bool ownedByPool() const override { return true; }
+
+private:
+    std::coroutine_handle<> handle;
+    bool* cancelled;  // 指向协程帧中 ScheduleAwaiter 的标志
+};
+
+// co_await schedule(pool) 把当前协程挂起, 放到 pool 的工作线程中继续执行
+// 排队期间传入的 token 被取消, 或者线程池停止时, co_await 抛出 TaskCancelled
+class ScheduleAwaiter {
+public:
+    ScheduleAwaiter(ThreadPool& pool, const CancelToken* token) : pool(pool), token(token), cancelled(false) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    // 返回 false 表示不挂起, 直接在当前线程继续 (任务被 Fail 策略拒绝时)
+    bool await_suspend(std::coroutine_handle<> handle) {
+        ResumeTask* task = new (blockAllocate(sizeof(ResumeTask), alignof(ResumeTask))) ResumeTask(handle, &cancelled);
+        task->setCancelToken(token);
+        if (pool.addTask(task) != 0) {
+            task->~ResumeTask();
+            blockDeallocate(task, sizeof(ResumeTask), alignof(ResumeTask));
+            return false;
+        }
+        return true;
+    }
+
+    void await_resume() const {
+        if (cancelled) {
+            throw TaskCancelled();
+        }
+    }
+
+private:
+    ThreadPool& pool;
+    const CancelToken* token;
+    bool cancelled;
+};
+
+inline ScheduleAwaiter schedule(ThreadPool& pool, const CancelToken* token = nullptr) {
+    return ScheduleAwaiter(pool, token);
+}
+
+template <typename T>
+class CoTask;
+
+// promise 中与返回值类型无关的部分
+class CoPromiseBase {
+public:
+    // 协程帧从 BlockPool 分配 和全局 operator new(size_t) 一样只保证 max_align_t 对齐
+    static void* operator new(size_t n) { return blockAllocate(n); }
+    static void operator delete(void* p, size_t n) { blockDeallocate(p, n); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // 结束时切换到等待者; syncWait 启动的协程没有等待者, 通知 syncWait 后停在这里
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            CoPromiseBase& p = handle.promise();
+            if (p.continuation) {
+                return p.continuation;
+            }
+            // 写入 done 之后协程帧随时可能被销毁, 不能再访问 p
+            std::atomic<uint32_t>* done = p.done;
+            done->store(1, std::memory_order_release);
+            futexWake(done);
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;  // 等待本协程的协程
+    std::atomic<uint32_t>* done = nullptr; // syncWait 等待的标志
+    std::exception_ptr error;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase {
+public:
+    CoPromise() : has_value(false) {}
+    ~CoPromise() {
+        if (has_value) reinterpret_cast<T*>(buf)->~T();
+    }
+
+    CoTask<T> get_return_object();
+
+    template <typename U>
+    void return_value(U&& value) {
+        new (buf) T(std::forward<U>(value));
+        has_value = true;
+    }
+
+    T result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*reinterpret_cast<T*>(buf));
+    }
+
+private:
+    alignas(T) unsigned char buf[sizeof(T)];
+    bool has_value;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase {
+public:
+    CoTask<void> get_return_object();
+
+    void return_void() {}
+
+    void result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// 协程的返回类型 只能移动, 析构时销毁协程帧
+template <typename T = void>
+class CoTask {
+public:
+    using promise_type = CoPromise<T>;
+
+    CoTask() : handle(nullptr) {}
+    explicit CoTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    CoTask(CoTask&& other) : handle(other.handle) { other.handle = nullptr; }
+    CoTask& operator=(CoTask&& other) {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask() {
+        if (handle) handle.destroy();
+    }
+
+    // co_await 一个 CoTask: 记下等待者, 然后直接切换过去执行
+    struct Awaiter {
+        std::coroutine_handle<promise_type> handle;
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept {
+            handle.promise().continuation = waiter;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await() && { return Awaiter{handle}; }
+
+    // 在当前线程启动协程, 阻塞等待它结束并返回结果
+    friend T syncWait(CoTask&& task) {
+        std::atomic<uint32_t> done(0);
+        task.handle.promise().done = &done;
+        task.handle.resume();
+        int idle_rounds = 0;
+        while (done.load(std::memory_order_acquire) == 0) {
+            // 在工作线程中调用时先帮忙执行排队的任务
+            if (helpPendingTask()) {
+                idle_rounds = 0;
+            } else if (++idle_rounds > 64) {
+                futexWait(&done, 0);
+            }
+        }
+        return task.handle.promise().result();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+CoTask<T> CoPromise<T>::get_return_object() {
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object() {
+    return CoTask<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
@@ -0,0 +1,108 @@
+#include "cpu_topology.h"
+
+#include <sched.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+// 读取 /sys/devices/system/cpu/cpu<cpu>/topology/<name> 中的整数, 失败返回 -1
+static int readTopologyValue(int cpu, const char* name) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return -1;
+    }
+    int value = -1;
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(fp);
+    return value;
+}
+
+std::vector<CpuInfo> readCpuTopology() {
+    std::vector<CpuInfo> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return cpus;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        CpuInfo info;
+        info.cpu = cpu;
+        info.core = readTopologyValue(cpu, "core_id");
+        info.socket = readTopologyValue(cpu, "physical_package_id");
+        info.smt = 0;
+        if (info.core < 0 || info.socket < 0) {
+            info.core = cpu;
+            info.socket = cpu;
+        }
+        cpus.push_back(info);
+    }
+
+    // 同一个物理核上的 CPU 按编号依次编号 smt
+    for (size_t i = 0; i < cpus.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (cpus[j].socket == cpus[i].socket && cpus[j].core == cpus[i].core) {
+                cpus[i].smt++;
+            }
+        }
+    }
+    return cpus;
+}
+
+std::vector<CpuInfo> placeWorkers(const std::vector<CpuInfo>& cpus, int n, Affinity affinity) {
+    std::vector<CpuInfo> order(cpus);
+    std::vector<CpuInfo> res;
+    if (affinity == Affinity::None || order.empty()) {
+        return res;
+    }
+
+    if (affinity == Affinity::Pack) {
+        std::sort(order.begin(), order.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            if (a.socket != b.socket) return a.socket < b.socket;
+            if (a.core != b.core) return a.core < b.core;
+            return a.smt < b.smt;
+        });
+    } else {
+        // 每个 CPU 在自己 socket 内 (相同 smt 序号的 CPU 中) 的排名, 按 (smt, 排名, socket) 排序
+        // 相邻的工作线程落在不同的 socket 上, 所有物理核用完之后才用超线程
+        std::vector<int> rank(order.size(), 0);
+        for (size_t i = 0; i < order.size(); i++) {
+            for (size_t j = 0; j < order.size(); j++) {
+                if (order[j].socket == order[i].socket && order[j].smt == order[i].smt &&
+                    order[j].core < order[i].core) {
+                    rank[i]++;
+                }
+            }
+        }
+        std::vector<size_t> idx(order.size());
+        for (size_t i = 0; i < idx.size(); i++) idx[i] = i;
+        std::sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+            if (order[a].smt != order[b].smt) return order[a].smt < order[b].smt;
+            if (rank[a] != rank[b]) return rank[a] < rank[b];
+            return order[a].socket < order[b].socket;
+        });
+        std::vector<CpuInfo> sorted;
+        for (size_t i = 0; i < idx.size(); i++) sorted.push_back(order[idx[i]]);
+        order.swap(sorted);
+    }
+
+    for (int i = 0; i < n; i++) {
+        res.push_back(order[i % order.size()]);
+    }
+    return res;
+}
+
+int cpuDistance(const CpuInfo& a, const CpuInfo& b) {
+    if (a.socket != b.socket) {
+        return 2;
+    }
+    return a.core == b.core ? 0 : 1;
+}
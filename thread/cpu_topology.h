@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+// 从 /sys/devices/system/cpu 读取的 CPU 拓扑
+struct CpuInfo {
+    int cpu;     // 逻辑 CPU 编号
+    int core;    // 物理核编号 (core_id, 只在同一个 socket 内唯一)
+    int socket;  // physical_package_id
+    int smt;     // 在同一个物理核的超线程中的序号, 0 是第一个
+};
+
+// 工作线程的放置方式
+enum class Affinity {
+    None,    // 不绑定, 由操作系统调度
+    Spread,  // 尽量分散: 轮流使用每个 socket, 先占满物理核, 最后才用超线程
+    Pack,    // 尽量集中: 先占满一个 socket, 同一个物理核的超线程相邻
+};
+
+// 读取当前进程可以使用的 (sched_getaffinity) CPU 的拓扑, 按 CPU 编号排序
+// 读不到拓扑信息的 CPU 当作单独的 socket 上的单独的核
+std::vector<CpuInfo> readCpuTopology();
+
+// 按 affinity 的方式给 n 个工作线程选择 CPU, CPU 不够时循环使用
+// Affinity::None 返回空
+std::vector<CpuInfo> placeWorkers(const std::vector<CpuInfo>& cpus, int n, Affinity affinity);
+
+// 两个 CPU 之间的距离 0: 同一个物理核, 1: 同一个 socket, 2: 不同 socket
+int cpuDistance(const CpuInfo& a, const CpuInfo& b);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+// futex 系统调用的简单封装
+// 只在有线程需要睡眠时才进入内核, 不需要为每个等待对象准备 mutex + cond
+
+// *addr 仍等于 expected 时睡眠, 直到被 futexWake 唤醒 (也可能被误唤醒, 调用者需要循环检查)
+inline void futexWait(std::atomic<uint32_t>* addr, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+// 同上, 最多睡眠 timeout_ns 纳秒 (单调时钟), 超时返回 false
+inline bool futexWait(std::atomic<uint32_t>* addr, uint32_t expected, uint64_t timeout_ns) {
+    timespec ts;
+    ts.tv_sec = time_t(timeout_ns / 1000000000);
+    ts.tv_nsec = long(timeout_ns % 1000000000);
+    long ret = syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+    return !(ret == -1 && errno == ETIMEDOUT);
+}
+
+// 唤醒最多 n 个睡眠在 addr 上的线程
+inline void futexWake(std::atomic<uint32_t>* addr, int n = INT_MAX) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+}
@@ -0,0 +1,98 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+    count += other.count;
+    sum += other.sum;
+    if (other.max > max) {
+        max = other.max;
+    }
+    for (size_t i = 0; i < buckets.size(); i++) buckets[i] += other.buckets[i];
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    // 至少要覆盖 rank 个值
+    uint64_t rank = uint64_t(p / 100 * double(count) + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t v = bucketHigh(i);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+void LatencyHistogram::collect(HistogramSnapshot& snapshot) const {
+    // 各个字段分别读, 与写入线程并发时 count 和各桶之和可能差几个
+    snapshot.count += count.get();
+    snapshot.sum += sum.get();
+    if (max.get() > snapshot.max) {
+        snapshot.max = max.get();
+    }
+    for (size_t i = 0; i < HistogramSnapshot::bucket_num; i++) snapshot.buckets[i] += buckets[i].get();
+}
+
+// 一个 summary: 分位数, 总和, 个数, 单位秒
+static void appendSummary(std::string& out, const std::string& name, const HistogramSnapshot& h) {
+    char line[256];
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    snprintf(line, sizeof(line), "# TYPE %s summary\n", name.c_str());
+    out += line;
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9f\n", name.c_str(), quantiles[i],
+                 double(h.percentile(quantiles[i] * 100)) / 1e9);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", name.c_str(), double(h.sum) / 1e9, name.c_str(),
+             (unsigned long long)h.count);
+    out += line;
+}
+
+// 每个工作线程一行, seconds 为 true 时把纳秒换算成秒
+static void appendWorkers(std::string& out, const std::string& name, const char* type,
+                          const std::vector<WorkerMetrics>& workers, uint64_t WorkerMetrics::*field, bool seconds) {
+    char line[256];
+    snprintf(line, sizeof(line), "# TYPE %s %s\n", name.c_str(), type);
+    out += line;
+    for (size_t i = 0; i < workers.size(); i++) {
+        uint64_t v = workers[i].*field;
+        if (seconds) {
+            snprintf(line, sizeof(line), "%s{worker=\"%d\"} %.9f\n", name.c_str(), workers[i].index, double(v) / 1e9);
+        } else {
+            snprintf(line, sizeof(line), "%s{worker=\"%d\"} %llu\n", name.c_str(), workers[i].index,
+                     (unsigned long long)v);
+        }
+        out += line;
+    }
+}
+
+std::string PoolMetrics::toText(const std::string& prefix) const {
+    std::string out;
+    char line[256];
+    const char* p = prefix.c_str();
+
+    snprintf(line, sizeof(line), "# TYPE %s_threads gauge\n%s_threads %d\n", p, p, live_threads);
+    out += line;
+    snprintf(line, sizeof(line), "# TYPE %s_queued_tasks gauge\n%s_queued_tasks %zu\n", p, p, queued);
+    out += line;
+
+    appendWorkers(out, prefix + "_tasks_total", "counter", workers, &WorkerMetrics::tasks, false);
+    appendWorkers(out, prefix + "_steals_total", "counter", workers, &WorkerMetrics::steals, false);
+    appendWorkers(out, prefix + "_wakeups_total", "counter", workers, &WorkerMetrics::wakeups, false);
+    appendWorkers(out, prefix + "_cancelled_total", "counter", workers, &WorkerMetrics::cancelled, false);
+    appendWorkers(out, prefix + "_busy_seconds_total", "counter", workers, &WorkerMetrics::busy_ns, true);
+    appendWorkers(out, prefix + "_idle_seconds_total", "counter", workers, &WorkerMetrics::idle_ns, true);
+
+    appendSummary(out, prefix + "_queue_wait_seconds", queue_wait);
+    appendSummary(out, prefix + "_run_seconds", run_time);
+    return out;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 线程池的运行统计
+// 每个工作线程只写自己的计数器和直方图 (原子变量的 load + store, 没有原子读改写, 也不共享 cache line)
+// 读取时把所有线程的数据加起来, 读到的是近似的快照
+
+// 只有一个线程写的计数器, 其他线程可以随时读
+class Counter {
+public:
+    Counter() : value(0) {}
+    void add(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void set(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+// 直方图的快照 可以相加, 可以求分位数
+struct HistogramSnapshot {
+    // 值小于 8 的每个值一个桶, 之后每个 2 的幂区间分成 8 个桶, 相对误差不超过 12.5% (与 HdrHistogram 的思路相同)
+    enum { sub_buckets = 8, bucket_num = 62 * sub_buckets };
+
+    HistogramSnapshot() : count(0), sum(0), max(0), buckets(bucket_num, 0) {}
+
+    static size_t bucketOf(uint64_t v) {
+        if (v < sub_buckets) {
+            return size_t(v);
+        }
+        int e = 63 - __builtin_clzll(v);  // v 的最高位, 至少为 3
+        return size_t(e - 2) * sub_buckets + size_t((v >> (e - 3)) & (sub_buckets - 1));
+    }
+
+    // 第 i 个桶中的最大值
+    static uint64_t bucketHigh(size_t i) {
+        if (i < sub_buckets) {
+            return i;
+        }
+        int e = int(i / sub_buckets) + 2;
+        uint64_t low = uint64_t(sub_buckets + i % sub_buckets) << (e - 3);
+        return low + (uint64_t(1) << (e - 3)) - 1;
+    }
+
+    void merge(const HistogramSnapshot& other);
+    // 第 p 百分位 (0 到 100) 的近似值, 没有数据返回 0
+    uint64_t percentile(double p) const;
+
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    std::vector<uint64_t> buckets;
+};
+
+// 只有一个线程写的延迟直方图 (纳秒)
+class LatencyHistogram {
+public:
+    void record(uint64_t ns) {
+        buckets[HistogramSnapshot::bucketOf(ns)].add(1);
+        count.add(1);
+        sum.add(ns);
+        if (ns > max.get()) {
+            max.set(ns);
+        }
+    }
+
+    // 加到 snapshot 上
+    void collect(HistogramSnapshot& snapshot) const;
+
+private:
+    Counter count;
+    Counter sum;
+    Counter max;
+    Counter buckets[HistogramSnapshot::bucket_num];
+};
+
+// 一个工作线程的统计 由该线程写, 单独占 cache line, 不和其他线程的数据伪共享
+struct alignas(64) WorkerCounters {
+    Counter tasks;      // 执行的任务数
+    Counter steals;     // 从其他线程偷到的任务数
+    Counter wakeups;    // 睡眠后被唤醒的次数
+    Counter cancelled;  // 因为已经取消没有执行就丢弃的任务数
+    Counter idle_ns;    // 自旋和睡眠等待任务的时间
+    Counter retired_ns; // 之前在这个位置上运行过的线程的总运行时间
+    std::atomic<uint64_t> start_time;  // 当前线程的启动时间, 0 表示没有在运行
+    std::atomic<uint64_t> idle_since;  // 这次开始空闲的时间, 0 表示没有在空闲
+    LatencyHistogram queue_wait;       // 任务从提交到开始执行的时间
+    LatencyHistogram run_time;         // Task::run 的执行时间
+
+    WorkerCounters() : start_time(0), idle_since(0) {}
+
+    void idleBegin(uint64_t now) { idle_since.store(now, std::memory_order_relaxed); }
+    void idleEnd(uint64_t now) {
+        idle_ns.add(now - idle_since.load(std::memory_order_relaxed));
+        idle_since.store(0, std::memory_order_relaxed);
+    }
+};
+
+// 一个工作线程统计的快照
+struct WorkerMetrics {
+    int index;
+    bool running;
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t wakeups;
+    uint64_t cancelled;
+    uint64_t busy_ns;    // 运行时间减去空闲时间
+    uint64_t idle_ns;
+};
+
+// 整个线程池统计的快照
+struct PoolMetrics {
+    std::vector<WorkerMetrics> workers;
+    HistogramSnapshot queue_wait;  // 所有线程合并, 只包括 enableMetrics 之后的任务
+    HistogramSnapshot run_time;
+    size_t queued;                 // 排队的任务数
+    int live_threads;
+
+    // Prometheus 文本格式, 每个指标以 prefix 开头
+    std::string toText(const std::string& prefix = "threadpool") const;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 有界多生产者多消费者无锁队列 (Dmitry Vyukov 的环形队列)
+// 每个槽位带一个序号, 生产者和消费者只用 CAS 抢占位置, 然后按序号判断槽位是否可写 / 可读
+//   seq == pos       槽位空闲, 位置 pos 的生产者可以写
+//   seq == pos + 1   槽位已写入, 位置 pos 的消费者可以读
+// 读完后 seq 设为 pos + capacity, 留给下一圈的生产者
+template <typename T>
+class MPMCQueue {
+public:
+    // 容量向上取整到 2 的幂
+    explicit MPMCQueue(size_t capacity) : enqueue_pos(0), dequeue_pos(0) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask = n - 1;
+        slots = new Slot[n];
+        for (size_t i = 0; i < n; i++) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MPMCQueue() { delete[] slots; }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    // 队列满返回 false
+    bool push(T* x) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 上一圈的元素还没被取走
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->data = x;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空返回 nullptr
+    T* pop() {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        T* x = slot->data;
+        slot->seq.store(pos + mask + 1, std::memory_order_release);
+        return x;
+    }
+
+    // 批量入队 一次 CAS 占住连续的 k 个位置, 返回实际入队的个数 k (队列满时为 0)
+    size_t push(T* const* items, size_t n) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            // 从 pos 开始连续空闲的槽位个数
+            size_t k = 0;
+            while (k < n && slots[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k) k++;
+            if (k == 0) {
+                size_t seq = slots[pos & mask].seq.load(std::memory_order_acquire);
+                if (intptr_t(seq) - intptr_t(pos) < 0) {
+                    return 0;
+                }
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            } else if (enqueue_pos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; i++) {
+                    Slot* slot = &slots[(pos + i) & mask];
+                    slot->data = items[i];
+                    slot->seq.store(pos + i + 1, std::memory_order_release);
+                }
+                return k;
+            }
+        }
+    }
+
+    // 批量出队 一次 CAS 取走最多 n 个, 返回实际取到的个数
+    size_t pop(T** out, size_t n) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            // 从 pos 开始连续已写入的槽位个数
+            size_t k = 0;
+            while (k < n && slots[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + 1) k++;
+            if (k == 0) {
+                size_t seq = slots[pos & mask].seq.load(std::memory_order_acquire);
+                if (intptr_t(seq) - intptr_t(pos + 1) < 0) {
+                    return 0;
+                }
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            } else if (dequeue_pos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < k; i++) {
+                    Slot* slot = &slots[(pos + i) & mask];
+                    out[i] = slot->data;
+                    slot->seq.store(pos + i + mask + 1, std::memory_order_release);
+                }
+                return k;
+            }
+        }
+    }
+
+    // 近似的元素个数 并发修改时只能作为参考
+    size_t size() const {
+        size_t e = enqueue_pos.load(std::memory_order_relaxed);
+        size_t d = dequeue_pos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    // 每个槽位独占一个 cache line, 相邻槽位的生产者和消费者互不干扰
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq;
+        T* data;
+    };
+
+    Slot* slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueue_pos;
+    alignas(64) std::atomic<size_t> dequeue_pos;
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <vector>
+
+#include "block_pool.h"
+#include "futex.h"
+#include "thread_pool.h"
+
+// 基于 ThreadPool 的数据并行原语
+//
+// 区间 [first, last) 按 grain 切成若干块, 任务递归地一分为二:
+// 右半边作为新任务提交 (工作线程中提交会进入自己的队列, 空闲线程来偷), 左半边留在当前线程继续拆分
+// 调用线程自己执行最左边的块, 然后一边帮忙执行排队的任务一边等待所有块完成
+// first / last 可以是随机访问迭代器 (包括 stl_vector.h 中 vector 的迭代器), 也可以是整数下标
+// grain 为 0 时自动选择, 大约每个线程 8 块
+// parallel_for 可以传入 CancelToken: 取消后还没开始的块直接丢弃, 调用者仍然等到所有已提交的块结束才返回
+// 某一块抛出异常时, 还没开始的块不再处理; 等所有已提交的块结束后, 在调用线程重新抛出第一个异常
+
+// 等待一组任务完成
+// pending 初始为 1 代表等待者自己, 等待前调用一次 finish
+// 等待者只看 done, 保证最后一个 finish 写完 done 之后 ParallelJoin 才会被销毁
+// 任务抛出的异常用 fail 记录, 只保留第一个; 任务在 finish 之前调用, wait 返回后由等待者取出
+class ParallelJoin {
+public:
+    ParallelJoin() : pending(1), done(0), failed(false) {}
+
+    void add(long n) { pending.fetch_add(n, std::memory_order_relaxed); }
+
+    // wait 返回后可以重置, 再等待下一组任务
+    void reset() {
+        pending.store(1, std::memory_order_relaxed);
+        done.store(0, std::memory_order_relaxed);
+        failed.store(false, std::memory_order_relaxed);
+        error = nullptr;
+    }
+
+    void fail(std::exception_ptr e) {
+        if (!failed.exchange(true, std::memory_order_acq_rel)) {
+            error = std::move(e);
+        }
+    }
+
+    // 已经有任务失败, 还没开始的任务可以不再执行
+    bool hasFailed() const { return failed.load(std::memory_order_acquire); }
+
+    // wait 返回后调用, 取出第一个异常 (没有时为空)
+    std::exception_ptr takeError() { return std::move(error); }
+
+    void finish() {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.store(1, std::memory_order_release);
+            futexWake(&done);
+        }
+    }
+
+    // 没有可帮忙的任务时先自旋一会儿, 再在 futex 上睡眠
+    void wait(ThreadPool& pool) {
+        int idle_rounds = 0;
+        finish();
+        while (done.load(std::memory_order_acquire) == 0) {
+            if (pool.runPendingTask()) {
+                idle_rounds = 0;
+            } else if (++idle_rounds > 64) {
+                futexWait(&done, 0);
+            }
+        }
+    }
+
+private:
+    std::atomic<long> pending;
+    std::atomic<uint32_t> done;
+    std::atomic<bool> failed;
+    std::exception_ptr error;  // 第一个失败的任务写入, 之后只有等待者读取
+};
+
+// 一组任务 等待时调用线程帮忙执行排队的任务, 而不是阻塞
+// 任务中可以再建立 TaskGroup 并等待 (递归的分治), 所有工作线程都在等待时也不会死锁
+// 组可以整体取消或设置截止时间: 还没开始的任务从队列中取出时直接丢弃, 不占用工作线程
+// 任务抛出异常时, 组中还没开始的任务不再执行, wait 等所有任务结束后重新抛出第一个异常
+//
+//     TaskGroup group(pool);
+//     group.run([&] { left = fib(n - 1); });
+//     right = fib(n - 2);
+//     group.wait();
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+    // 析构不抛出异常, 没有被 wait 取走的异常直接丢弃
+    ~TaskGroup() { join.wait(pool); }
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // 提交 f(), f 按值保存在任务节点中; 组已经取消时不再提交
+    template <typename F>
+    void run(F&& f) {
+        if (token.isCancelled()) {
+            return;
+        }
+        using Node = GroupTask<std::decay_t<F>>;
+        join.add(1);
+        Node* node = new (blockAllocate(sizeof(Node), alignof(Node))) Node(std::forward<F>(f), &join, &token);
+        // 被拒绝 (Fail 策略) 时直接在当前线程执行
+        if (pool.addTask(node) != 0) {
+            node->run();
+        }
+    }
+
+    // 等待已提交的任务全部完成, 之后可以继续 run
+    void wait() {
+        join.wait(pool);
+        std::exception_ptr e = join.takeError();
+        join.reset();
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    // 取消还没有开始的任务, 正在执行的任务用 isCancelled() 或 currentTaskCancelled() 检查后提前返回
+    // 取消后一直有效, wait 之后也不会恢复
+    void cancel() { token.cancel(); }
+    // 到 deadline (ThreadPool::nowNs() 的时间) 时自动取消
+    void setDeadline(uint64_t deadline) { token.setDeadline(deadline); }
+    bool isCancelled() const { return token.isCancelled(); }
+
+private:
+    template <typename F>
+    class GroupTask : public Task {
+    public:
+        template <typename G>
+        GroupTask(G&& g, ParallelJoin* join, const CancelToken* token) : func(std::forward<G>(g)), join(join) {
+            setCancelToken(token);
+        }
+
+        void run() override {
+            ParallelJoin* j = join;
+            if (!j->hasFailed()) {
+                try {
+                    func();
+                } catch (...) {
+                    j->fail(std::current_exception());
+                }
+            }
+            this->~GroupTask();
+            blockDeallocate(this, sizeof(GroupTask), alignof(GroupTask));
+            j->finish();
+        }
+
+    protected:
+        void onCancel() override {
+            ParallelJoin* j = join;
+            this->~GroupTask();
+            blockDeallocate(this, sizeof(GroupTask), alignof(GroupTask));
+            j->finish();
+        }
+
+        bool ownedByPool() const override { return true; }
+
+    private:
+        F func;
+        ParallelJoin* join;
+    };
+
+    ThreadPool& pool;
+    ParallelJoin join;
+    CancelToken token;
+};
+
+// 处理第 [lo, hi) 块 第 c 块是 [first + c * grain, first + min((c + 1) * grain, n))
+// leaf(f, l, c) 处理一块
+template <typename Iter, typename Leaf>
+class ChunkTask : public Task {
+public:
+    struct Range {
+        ThreadPool* pool;
+        Iter first;
+        size_t n;
+        size_t grain;
+        Leaf* leaf;
+        ParallelJoin* join;
+        const CancelToken* token;  // nullptr 表示不能取消
+    };
+
+    ChunkTask(const Range* range, size_t lo, size_t hi) : range(range), lo(lo), hi(hi) {
+        setCancelToken(range->token);
+    }
+
+    void run() override {
+        const Range* r = range;
+        execute(r, lo, hi);
+        this->~ChunkTask();
+        blockDeallocate(this, sizeof(ChunkTask), alignof(ChunkTask));
+        r->join->finish();
+    }
+
+    // 不抛出异常: leaf 的异常记录到 join 中, 由 parallel_chunks 在所有块结束后重新抛出
+    static void execute(const Range* r, size_t lo, size_t hi) {
+        if ((r->token && r->token->isCancelled()) || r->join->hasFailed()) {
+            return;
+        }
+        try {
+            while (hi - lo > 1) {
+                size_t mid = lo + (hi - lo) / 2;
+                spawn(r, mid, hi);
+                hi = mid;
+            }
+            size_t f = lo * r->grain;
+            size_t l = std::min(f + r->grain, r->n);
+            (*r->leaf)(r->first + f, r->first + l, lo);
+        } catch (...) {
+            r->join->fail(std::current_exception());
+        }
+    }
+
+protected:
+    // 取消的块不再拆分, [lo, hi) 中还没提交的块不会计入 join
+    void onCancel() override {
+        const Range* r = range;
+        this->~ChunkTask();
+        blockDeallocate(this, sizeof(ChunkTask), alignof(ChunkTask));
+        r->join->finish();
+    }
+
+    bool ownedByPool() const override { return true; }
+
+private:
+    static void spawn(const Range* r, size_t lo, size_t hi) {
+        // 先分配再计数, 分配失败抛出异常时 join 的计数不变
+        ChunkTask* task = new (blockAllocate(sizeof(ChunkTask), alignof(ChunkTask))) ChunkTask(r, lo, hi);
+        r->join->add(1);
+        // 被拒绝 (Fail 策略) 时直接在当前线程执行
+        if (r->pool->addTask(task) != 0) {
+            task->run();
+        }
+    }
+
+    const Range* range;
+    size_t lo;
+    size_t hi;
+};
+
+inline size_t parallel_grain(ThreadPool& pool, size_t n, size_t grain) {
+    if (grain == 0) {
+        grain = n / (size_t(pool.getThreadNum() + 1) * 8);
+    }
+    return grain == 0 ? 1 : grain;
+}
+
+// 把 [first, last) 按 grain 分块并行处理, 返回后所有块都已处理完 (或因为取消被丢弃)
+// 有块抛出异常时, 等所有已提交的块结束后重新抛出第一个异常, 之后任务不再引用栈上的 range 和 join
+template <typename Iter, typename Leaf>
+void parallel_chunks(ThreadPool& pool, Iter first, Iter last, size_t grain, Leaf& leaf,
+                     const CancelToken* token = nullptr) {
+    size_t n = size_t(last - first);
+    if (n == 0) {
+        return;
+    }
+    ParallelJoin join;
+    typename ChunkTask<Iter, Leaf>::Range range = {&pool, first, n, grain, &leaf, &join, token};
+    ChunkTask<Iter, Leaf>::execute(&range, 0, (n + grain - 1) / grain);
+    join.wait(pool);
+    if (std::exception_ptr e = join.takeError()) {
+        std::rethrow_exception(e);
+    }
+}
+
+// 对每一块调用 body(f, l) token 取消后没有开始的块不再处理
+template <typename Iter, typename Body>
+void parallel_for(ThreadPool& pool, Iter first, Iter last, size_t grain, Body body,
+                  const CancelToken* token = nullptr) {
+    grain = parallel_grain(pool, size_t(last - first), grain);
+    auto leaf = [&body](Iter f, Iter l, size_t) { body(f, l); };
+    parallel_chunks(pool, first, last, grain, leaf, token);
+}
+
+template <typename Iter, typename Body>
+void parallel_for(ThreadPool& pool, Iter first, Iter last, Body body) {
+    parallel_for(pool, first, last, 0, body);
+}
+
+// 每一块求 body(f, l), 再按块的顺序用 combine 从 identity 开始合并
+// 合并顺序固定, combine 只需要满足结合律, 结果与分块方式无关 (浮点数除外)
+template <typename Iter, typename T, typename Body, typename Combine>
+T parallel_reduce(ThreadPool& pool, Iter first, Iter last, size_t grain, T identity, Body body, Combine combine) {
+    size_t n = size_t(last - first);
+    grain = parallel_grain(pool, n, grain);
+    std::vector<T> partial((n + grain - 1) / grain, identity);
+    auto leaf = [&body, &partial](Iter f, Iter l, size_t c) { partial[c] = body(f, l); };
+    parallel_chunks(pool, first, last, grain, leaf);
+
+    T result = identity;
+    for (size_t c = 0; c < partial.size(); c++) result = combine(result, partial[c]);
+    return result;
+}
+
+template <typename Iter, typename T, typename Body, typename Combine>
+T parallel_reduce(ThreadPool& pool, Iter first, Iter last, T identity, Body body, Combine combine) {
+    return parallel_reduce(pool, first, last, 0, identity, body, combine);
+}
+
+// 先并行地对每一块 std::sort, 再一轮一轮地两两归并 (每轮内的归并并行执行)
+// 最后一轮只有一次归并, 是 O(n) 的串行部分
+template <typename Iter, typename Compare>
+void parallel_sort(ThreadPool& pool, Iter first, Iter last, Compare comp) {
+    size_t n = size_t(last - first);
+    size_t grain = std::max(parallel_grain(pool, n, 0), size_t(2048));
+    if (n <= grain) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    auto sort_leaf = [&comp](Iter f, Iter l, size_t) { std::sort(f, l, comp); };
+    parallel_chunks(pool, first, last, grain, sort_leaf);
+
+    // 每轮把相邻两个长为 width 的有序段合并成一个
+    for (size_t width = grain; width < n; width *= 2) {
+        size_t pairs = (n + 2 * width - 1) / (2 * width);
+        auto merge_leaf = [&](size_t p, size_t, size_t) {
+            size_t f = p * 2 * width;
+            size_t m = std::min(f + width, n);
+            size_t l = std::min(f + 2 * width, n);
+            if (m < l) {
+                std::inplace_merge(first + f, first + m, first + l, comp);
+            }
+        };
+        parallel_chunks(pool, size_t(0), pairs, 1, merge_leaf);
+    }
+}
+
+template <typename Iter>
+void parallel_sort(ThreadPool& pool, Iter first, Iter last) {
+    parallel_sort(pool, first, last, std::less<typename std::iterator_traits<Iter>::value_type>());
+}
@@ -0,0 +1,125 @@
+#include "task_graph.h"
+
+TaskGraph::~TaskGraph() {
+    for (size_t i = 0; i < nodes.size(); i++) {
+        delete nodes[i];
+    }
+}
+
+void TaskGraph::Node::run() {
+    Node* node = this;
+    // 用循环代替递归执行延续, 长链不会把栈撑爆
+    while (node) {
+        // 延续不经过线程池, 在这里检查取消; 已经有节点抛出异常时, 剩下的节点和取消一样丢弃
+        const CancelToken* token = node->getCancelToken();
+        if ((token && token->isCancelled()) || graph->join->hasFailed()) {
+            node->onCancel();
+            return;
+        }
+        try {
+            node->func();
+        } catch (...) {
+            graph->join->fail(std::current_exception());
+            node->onCancel();
+            return;
+        }
+
+        Node* next = nullptr;
+        for (size_t i = 0; i < node->successors.size(); i++) {
+            Node* s = node->successors[i];
+            if (s->join_counter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (next) {
+                    graph->schedule(next);
+                }
+                next = s;
+            }
+        }
+
+        // next 还没完成, 所以这里不会是最后一次 finish, 图在 next 执行完之前不会被销毁
+        graph->join->finish();
+        node = next;
+    }
+}
+
+void TaskGraph::Node::onCancel() {
+    // 用显式的栈代替递归, 长链不会把栈撑爆
+    std::vector<Node*> stack(1, this);
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        for (size_t i = 0; i < node->successors.size(); i++) {
+            Node* s = node->successors[i];
+            if (s->join_counter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                stack.push_back(s);
+            }
+        }
+        // 栈中的节点还没完成, 所以这里不会是最后一次 finish
+        graph->join->finish();
+    }
+}
+
+void TaskGraph::schedule(Node* node) {
+    // 被拒绝 (Fail 策略) 时直接在当前线程执行
+    if (pool->addTask(node) != 0) {
+        node->run();
+    }
+}
+
+bool TaskGraph::acyclic() {
+    // Kahn 算法: 从没有前驱的节点开始, 每去掉一个节点就把它后继的计数减一, 减到 0 的也可以去掉
+    // 有环时环上 (以及环之后) 的节点计数减不到 0, 去掉的节点数少于总数
+    std::vector<Node*> ready(sources);
+    size_t removed = 0;
+    while (!ready.empty()) {
+        Node* node = ready.back();
+        ready.pop_back();
+        removed++;
+        for (size_t i = 0; i < node->successors.size(); i++) {
+            Node* s = node->successors[i];
+            if (s->join_counter.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                ready.push_back(s);
+            }
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i]->join_counter.store(nodes[i]->num_predecessors, std::memory_order_relaxed);
+    }
+    return removed == nodes.size();
+}
+
+int TaskGraph::run(ThreadPool& pool, const CancelToken* token) {
+    sources.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i]->setCancelToken(token);
+        nodes[i]->join_counter.store(nodes[i]->num_predecessors, std::memory_order_relaxed);
+        if (nodes[i]->num_predecessors == 0) {
+            sources.push_back(nodes[i]);
+        }
+    }
+    if (nodes.empty()) {
+        return 0;
+    }
+    // 有环时环上的节点永远等不到前驱完成, run 会一直等下去; 结构没有变化就不用再检查
+    if (!checked) {
+        if (!acyclic()) {
+            return -1;
+        }
+        checked = true;
+    }
+
+    ParallelJoin done;
+    this->pool = &pool;
+    this->join = &done;
+    done.add(long(nodes.size()));
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        schedule(sources[i]);
+    }
+
+    done.wait(pool);
+    this->join = nullptr;
+    if (std::exception_ptr e = done.takeError()) {
+        std::rethrow_exception(e);
+    }
+    return 0;
+}
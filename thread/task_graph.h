@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+#include "thread_pool.h"
+
+// 任务依赖图 (DAG)
+// 每个节点记录前驱个数, 运行时前驱每完成一个计数减一, 减到 0 的节点马上可以执行
+// 一个节点完成后, 它的后继中最后一个就绪的直接在当前线程接着执行 (延续), 其余的提交到线程池
+// 图只需要建立一次, 每次 run 只重置计数, 不分配内存
+//
+//     TaskGraph g;
+//     TaskGraph::Node* a = g.emplace([] { load(); });
+//     TaskGraph::Node* b = g.emplace([] { parse(); });
+//     TaskGraph::Node* c = g.emplace([] { index(); });
+//     a->precede(b);
+//     a->precede(c);
+//     g.run(pool);
+class TaskGraph {
+public:
+    class Node final : public Task {
+    public:
+        // this 完成之后才能执行 other
+        void precede(Node* other) {
+            successors.push_back(other);
+            other->num_predecessors++;
+            graph->checked = false;
+        }
+
+        // other 完成之后才能执行 this
+        void succeed(Node* other) { other->precede(this); }
+
+        void run() override;
+
+    protected:
+        // 取消的节点不执行, 但要照常减掉后继的计数, 否则 run 永远等不到它们完成
+        // 因此变为就绪的后继也一起丢弃, 不再提交
+        void onCancel() override;
+        // 节点属于图, 线程池停止时同样要经过 onCancel, 否则 run 等不到它完成
+        bool ownedByPool() const override { return true; }
+
+    private:
+        friend class TaskGraph;
+
+        template <typename F>
+        Node(TaskGraph* graph, F&& f) : graph(graph), func(std::forward<F>(f)), num_predecessors(0), join_counter(0) {}
+
+        TaskGraph* graph;
+        std::function<void()> func;
+        std::vector<Node*> successors;
+        int num_predecessors;
+        std::atomic<int> join_counter;  // 本次运行中还没完成的前驱数
+    };
+
+    TaskGraph() : pool(nullptr), join(nullptr), checked(true) {}
+    ~TaskGraph();
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // 添加一个执行 f() 的节点
+    template <typename F>
+    Node* emplace(F&& f) {
+        Node* node = new Node(this, std::forward<F>(f));
+        nodes.push_back(node);
+        return node;
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    // 在 pool 上执行整个图, 调用线程帮忙执行任务直到所有节点完成
+    // token 取消后还没开始的节点不再执行, run 在已经开始的节点结束后返回
+    // 节点抛出异常时同样丢弃还没开始的节点, 在已经开始的节点结束后重新抛出第一个异常
+    // 同一个图不能同时运行多次 图中有环时不执行任何节点, 返回 -1
+    int run(ThreadPool& pool, const CancelToken* token = nullptr);
+
+private:
+    void schedule(Node* node);
+    bool acyclic();  // 图中是否没有环, 用到 join_counter, 调用前它们等于前驱数
+
+    std::vector<Node*> nodes;
+    std::vector<Node*> sources;  // 没有前驱的节点, run 时重新计算
+    ThreadPool* pool;            // 本次运行使用的线程池
+    ParallelJoin* join;          // 等待本次运行的所有节点完成
+    bool checked;                // 上次检查过没有环之后图的结构没有变化
+};
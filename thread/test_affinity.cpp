@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+
+int main() {
+    // 2 个 socket, 每个 4 个物理核, 每个核 2 个超线程; CPU 编号 socket * 8 + core * 2 + smt
+    std::vector<CpuInfo> fake;
+    for (int s = 0; s < 2; s++) {
+        for (int c = 0; c < 4; c++) {
+            for (int t = 0; t < 2; t++) fake.push_back({s * 8 + c * 2 + t, c, s, t});
+        }
+    }
+
+    // Spread: 相邻的线程在不同的 socket 上, 物理核用完之后才用超线程, CPU 不够时循环
+    std::vector<CpuInfo> spread = placeWorkers(fake, 20, Affinity::Spread);
+    assert(spread.size() == 20);
+    int expect[] = {0, 8, 2, 10, 4, 12, 6, 14, 1, 9, 3, 11, 5, 13, 7, 15};
+    for (int i = 0; i < 20; i++) assert(spread[i].cpu == expect[i % 16]);
+
+    // Pack: 先占满一个 socket, 同一个物理核的超线程相邻
+    std::vector<CpuInfo> pack = placeWorkers(fake, 10, Affinity::Pack);
+    for (int i = 0; i < 10; i++) assert(pack[i].cpu == i);
+
+    assert(placeWorkers(fake, 4, Affinity::None).empty());
+    assert(placeWorkers(std::vector<CpuInfo>(), 4, Affinity::Spread).empty());
+
+    assert(cpuDistance(fake[0], fake[1]) == 0);
+    assert(cpuDistance(fake[0], fake[2]) == 1);
+    assert(cpuDistance(fake[0], fake[8]) == 2);
+
+    // 读到的都是当前进程可以使用的 CPU
+    std::vector<CpuInfo> topology = readCpuTopology();
+    assert(!topology.empty());
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (auto& c : topology) assert(CPU_ISSET(c.cpu, &allowed));
+
+    // 指定 CPU 的线程池: 任务都在那个 CPU 上执行
+    {
+        int cpu = topology.back().cpu;
+        ThreadPool pool(2, std::vector<int>{cpu});
+        std::vector<Future<int>> futures;
+        for (int i = 0; i < 100; i++) futures.push_back(pool.submit([] { return sched_getcpu(); }));
+        for (auto& f : futures) assert(f.get() == cpu);
+        pool.shutdown();
+    }
+
+    // 按拓扑放置的线程池照常工作
+    for (Affinity a : {Affinity::Spread, Affinity::Pack}) {
+        ThreadPool pool(3, 64, OverflowPolicy::Block, a);
+        std::atomic<int> ran(0);
+        for (int i = 0; i < 1000; i++) pool.submit([&] { ran++; });
+        pool.waitIdle();
+        assert(ran == 1000);
+        pool.shutdown();
+    }
+
+    printf("affinity ok\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "async_io.h"
+
+// 自己提供的完成任务 读写的参数和结果都在任务里
+struct ReadDone : IoTask {
+    std::atomic<ssize_t>* result;
+    void run() override { *result = getResult(); }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+int main() {
+    const char* path = "/tmp/test_async_io.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    const int blocks = 1024, bs = 4096;
+    std::vector<char> data(size_t(blocks) * bs);
+    for (size_t i = 0; i < data.size(); i++) data[i] = char(i * 131 + 7);
+
+    // io_uring (内核支持时) 和退回的 I/O 线程各跑一遍
+    for (int mode = 0; mode < 2; mode++) {
+        ThreadPool pool(4);
+        std::atomic<int> ok(0), bad(0);
+        {
+            AsyncIO io(pool, 64, 4, mode == 0);
+            assert(mode == 0 || !io.usingUring());
+            printf("io_uring: %d\n", io.usingUring());
+            for (int i = 0; i < blocks; i++) {
+                int ret = io.write(fd, &data[size_t(i) * bs], bs, uint64_t(i) * bs,
+                                   [&](ssize_t n) { (n == bs ? ok : bad)++; });
+                assert(ret == 0);
+            }
+        }
+        // 析构时所有回调都已经交给线程池
+        pool.waitIdle();
+        assert(ok == blocks && bad == 0);
+
+        std::vector<char> out(data.size());
+        std::atomic<ssize_t> ebadf(0), whole(0);
+        ok = 0;
+        {
+            AsyncIO io(pool, 64, 4, mode == 0);
+            for (int i = 0; i < blocks; i++) {
+                io.read(fd, &out[size_t(i) * bs], bs, uint64_t(i) * bs, [&](ssize_t n) { (n == bs ? ok : bad)++; });
+            }
+            // 出错时结果是 -errno
+            io.read(-1, &out[0], 1, 0, [&](ssize_t n) { ebadf = n; });
+
+            ReadDone done;
+            done.result = &whole;
+            std::vector<char> tail(100);
+            assert(io.read(fd, tail.data(), tail.size(), data.size() - 10, &done) == 0);
+            while (whole == 0) usleep(100);
+            assert(whole == 10);
+        }
+        pool.waitIdle();
+        assert(ok == blocks && bad == 0 && ebadf == -EBADF);
+        assert(memcmp(out.data(), data.data(), data.size()) == 0);
+        pool.shutdown();
+    }
+
+    // 线程池拒绝回调任务 (Fail 策略且队列已满) 时, 回调在完成线程中执行, 不会丢失
+    for (int mode = 0; mode < 2; mode++) {
+        ThreadPool pool(1, 1, OverflowPolicy::Fail);
+        std::atomic<int> go(0), ran(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        while (pool.getTaskSize() != 0) usleep(100);
+        {
+            AsyncIO io(pool, 8, 2, mode == 0);
+            char buf[16];
+            for (int i = 0; i < 100; i++) {
+                assert(io.read(fd, buf, sizeof(buf), 0, [&](ssize_t n) { ran += n == sizeof(buf); }) == 0);
+            }
+        }
+        go = 1;
+        pool.waitIdle();
+        assert(ran == 100);
+        pool.shutdown();
+    }
+
+    // 线程池已经停止: 回调同样执行
+    {
+        ThreadPool pool(1);
+        pool.shutdown();
+        std::atomic<int> ran(0);
+        {
+            AsyncIO io(pool);
+            char buf[16];
+            for (int i = 0; i < 10; i++) io.read(fd, buf, sizeof(buf), 0, [&](ssize_t) { ran++; });
+        }
+        assert(ran == 10);
+    }
+
+    close(fd);
+    unlink(path);
+    printf("async_io ok\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 记录自己执行的次数
+struct Count : Task {
+    std::atomic<int> runs{0};
+    std::atomic<long>* total;
+    void run() override {
+        runs++;
+        (*total)++;
+    }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+// 在工作线程中批量提交, 不受注入队列容量限制
+struct Spawner : Task {
+    ThreadPool* pool;
+    std::vector<Task*>* children;
+    int accepted = 0;
+    void run() override { accepted = pool->addTasks(children->data(), children->data() + children->size()); }
+};
+
+static std::vector<Task*> pointers(std::vector<Count>& tasks, std::atomic<long>* total) {
+    std::vector<Task*> ptrs;
+    for (auto& t : tasks) {
+        t.total = total;
+        ptrs.push_back(&t);
+    }
+    return ptrs;
+}
+
+int main() {
+    // 每种策略下批量提交的任务都恰好执行一次 (Fail 策略只执行被接受的部分)
+    for (int policy = 0; policy < 3; policy++) {
+        ThreadPool pool(4, 64, OverflowPolicy(policy));
+        std::atomic<long> total(0);
+        std::vector<Count> tasks(10000);
+        std::vector<Task*> ptrs = pointers(tasks, &total);
+        int accepted = pool.addTasks(ptrs.data(), ptrs.data() + ptrs.size());
+        pool.waitIdle();
+        assert(total == accepted);
+        for (int i = 0; i < accepted; i++) assert(tasks[i].runs == 1);
+        for (size_t i = accepted; i < tasks.size(); i++) assert(tasks[i].runs == 0);
+        if (OverflowPolicy(policy) != OverflowPolicy::Fail) {
+            assert(accepted == 10000);
+        }
+        pool.shutdown();
+    }
+
+    // 队列满: Fail 策略返回放进去的个数, 后面的任务被拒绝
+    {
+        ThreadPool pool(1, 16, OverflowPolicy::Fail);
+        std::atomic<int> go(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        while (pool.getTaskSize() != 0) usleep(100);
+
+        std::atomic<long> total(0);
+        std::vector<Count> tasks(100);
+        std::vector<Task*> ptrs = pointers(tasks, &total);
+        assert(pool.addTasks(ptrs.data(), ptrs.data() + ptrs.size()) == 16);
+        assert(pool.addTasks(ptrs.data() + 16, ptrs.data() + ptrs.size()) == 0);
+        go = 1;
+        pool.waitIdle();
+        assert(total == 16);
+
+        // 工作线程中提交的全部被接受
+        std::vector<Count> children(100);
+        std::vector<Task*> child_ptrs = pointers(children, &total);
+        Spawner spawner;
+        spawner.pool = &pool;
+        spawner.children = &child_ptrs;
+        pool.addTask(&spawner);
+        pool.waitIdle();
+        assert(spawner.accepted == 100 && total == 116);
+
+        // 空的区间和停止之后
+        assert(pool.addTasks(ptrs.data(), ptrs.data()) == 0);
+        pool.shutdown();
+        assert(pool.addTasks(ptrs.data(), ptrs.data() + ptrs.size()) == 0);
+        assert(total == 116);
+    }
+
+    printf("batch ok\n");
+    return 0;
+}
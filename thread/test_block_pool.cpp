@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+#include <set>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 统计全局 operator new 的调用次数
+// operator delete 不内联, 否则编译器会把 free 和 operator new 的返回值配对而报警告
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t n) {
+    allocations++;
+    void* p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct Deadline : Task {
+    std::atomic<long>* ran;
+    void run() override { (*ran)++; }
+};
+
+// 在工作线程中提交子任务, 走工作线程自己的队列
+struct Spawner : Task {
+    ThreadPool* pool;
+    std::vector<Deadline>* children;
+    void run() override {
+        for (auto& c : *children) pool->addTask(&c);
+    }
+};
+
+// 在另一个线程释放块
+void* freeAll(void* p) {
+    for (void* b : *static_cast<std::vector<void*>*>(p)) blockDeallocate(b, 128);
+    return nullptr;
+}
+
+int main() {
+    // 块互不重叠; 在别的线程释放的块回到全局链表, 之后可以重新分配
+    {
+        std::vector<void*> blocks;
+        std::set<void*> seen;
+        for (int i = 0; i < 1000; i++) {
+            blocks.push_back(blockAllocate(128));
+            assert(seen.insert(blocks.back()).second);
+        }
+        pthread_t t;
+        pthread_create(&t, nullptr, freeAll, &blocks);
+        pthread_join(t, nullptr);
+        std::vector<void*> again;
+        again.reserve(1000);
+        long before = allocations;
+        for (int i = 0; i < 1000; i++) blockDeallocate(blockAllocate(128), 128);
+        for (int i = 0; i < 1000; i++) again.push_back(blockAllocate(128));
+        assert(allocations == before);
+        for (void* b : again) blockDeallocate(b, 128);
+        // 超过 512 字节的直接用 operator new
+        blockDeallocate(blockAllocate(1000), 1000);
+        assert(allocations == before + 1);
+        // 对齐要求超过 max_align_t 的用带对齐的 operator new
+        for (int i = 0; i < 10; i++) {
+            void* p = blockAllocate(100, 64);
+            assert(uintptr_t(p) % 64 == 0);
+            blockDeallocate(p, 100, 64);
+        }
+    }
+
+    // 小任务的 submit 节点放得进 128 字节的块
+    {
+        auto f = [] {};
+        static_assert(sizeof(FunctionTask<void, decltype(f), std::tuple<>>) <= 128, "submit node too large");
+    }
+
+    ThreadPool pool(2);
+    const int n = 10000;
+    std::vector<Deadline> deadlines(n), children(n);
+    std::vector<Future<int>> futures;
+    futures.reserve(n);
+    std::atomic<long> ran(0);
+    for (auto& d : deadlines) d.ran = &ran;
+    for (auto& c : children) c.ran = &ran;
+    Spawner spawner;
+    spawner.pool = &pool;
+    spawner.children = &children;
+
+    // 截止时间任务, submit 和工作线程中提交的任务: 入队和任务节点都不分配内存
+    // 预热之后剩下的只有工作线程队列的数组翻倍 (只增不减), 和块暂时留在其他线程的本地缓存里时补充的大块
+    long used = 0;
+    for (int round = 0; round < 5; round++) {
+        long before = allocations;
+        unsigned seed = round;
+        uint64_t now = ThreadPool::nowNs();
+        for (auto& d : deadlines) pool.addDeadlineTask(&d, now + rand_r(&seed) % 1000000);
+        for (int i = 0; i < n; i++) futures.push_back(pool.submit([i] { return i; }));
+        pool.addTask(&spawner);
+        for (int i = 0; i < n; i++) assert(futures[i].get() == i);
+        futures.clear();
+        pool.waitIdle();
+        long k = allocations - before;
+        printf("round %d: %ld allocations\n", round, k);
+        if (round > 0) {
+            used += k;
+        }
+    }
+    assert(used < n / 100 && ran == 5 * 2 * n);
+
+    pool.shutdown();
+    printf("block_pool ok\n");
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "coroutine.h"
+#include "parallel.h"
+#include "task_graph.h"
+#include "thread_pool.h"
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+CoTask<int> resumeOn(ThreadPool& pool, const CancelToken* token) {
+    co_await schedule(pool, token);
+    co_return 1;
+}
+
+int main() {
+    ThreadPool pool(1);
+
+    // 排队的 submit 任务被取消: get 抛出 TaskCancelled, 不会一直等下去
+    {
+        std::atomic<int> go(0), ran(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+
+        CancelToken token;
+        std::vector<Future<int>> futures;
+        for (int i = 0; i < 100; i++) {
+            futures.push_back(pool.submit(&token, [&ran, i] {
+                ran++;
+                return i;
+            }));
+        }
+        Future<int> other = pool.submit([] { return 7; });
+        token.cancel();
+        go = 1;
+
+        int cancelled = 0;
+        for (auto& f : futures) {
+            try {
+                f.get();
+            } catch (const TaskCancelled&) {
+                cancelled++;
+            }
+        }
+        assert(cancelled == 100 && ran == 0);
+        assert(other.get() == 7);
+
+        // 已经取消的 token 提交的任务同样被丢弃, wait 能返回
+        Future<void> late = pool.submit(&token, [] {});
+        late.wait();
+        pool.waitIdle();
+    }
+
+    // parallel_for 中途取消: 没开始的块被丢弃, parallel_for 仍然返回
+    {
+        std::vector<int> v(100000, 1);
+        std::atomic<long> chunks(0);
+        CancelToken token;
+        parallel_for(
+            pool, v.begin(), v.end(), 100,
+            [&](std::vector<int>::iterator, std::vector<int>::iterator) {
+                if (++chunks == 10) token.cancel();
+            },
+            &token);
+        assert(chunks >= 10 && chunks < 1000);
+
+        // 开始之前就已经取消
+        chunks = 0;
+        parallel_for(
+            pool, v.begin(), v.end(), 100, [&](std::vector<int>::iterator, std::vector<int>::iterator) { chunks++; },
+            &token);
+        assert(chunks == 0);
+        pool.waitIdle();
+    }
+
+    // TaskGroup 取消后 wait 返回
+    {
+        std::atomic<int> go(0), ran(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        TaskGroup group(pool);
+        for (int i = 0; i < 50; i++) group.run([&] { ran++; });
+        group.cancel();
+        go = 1;
+        group.wait();
+        assert(ran == 0);
+        pool.waitIdle();
+    }
+
+    // 图中的节点取消 后面的节点不再执行, run 照常返回
+    {
+        TaskGraph graph;
+        CancelToken token;
+        std::atomic<int> ran(0);
+        TaskGraph::Node* prev = graph.emplace([&] {
+            ran++;
+            token.cancel();
+        });
+        for (int i = 0; i < 1000; i++) {
+            TaskGraph::Node* n = graph.emplace([&] { ran++; });
+            prev->precede(n);
+            prev = n;
+        }
+        assert(graph.run(pool, &token) == 0 && ran == 1);
+        pool.waitIdle();
+    }
+
+    // 排队等待恢复的协程被取消: co_await schedule 抛出 TaskCancelled
+    {
+        std::atomic<int> go(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        CancelToken token;
+        CoTask<int> task = resumeOn(pool, &token);
+        token.cancel();
+        go = 1;
+        bool thrown = false;
+        try {
+            syncWait(std::move(task));
+        } catch (const TaskCancelled&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(syncWait(resumeOn(pool, nullptr)) == 1);
+    }
+
+    PoolMetrics m = pool.getMetrics();
+    assert(m.workers.size() == 1 && m.workers[0].cancelled > 0);
+
+    pool.shutdown();
+    printf("cancel ok\n");
+    return 0;
+}
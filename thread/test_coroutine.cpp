@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "coroutine.h"
+
+CoTask<long> leaf(ThreadPool& pool, long x) {
+    co_await schedule(pool);
+    co_return x * 2;
+}
+
+// 依次等待很多子协程, 每个子协程都切换到工作线程
+CoTask<long> fan(ThreadPool& pool, int n) {
+    co_await schedule(pool);
+    long sum = 0;
+    for (int i = 0; i < n; i++) sum += co_await leaf(pool, i);
+    co_return sum;
+}
+
+// 同步的递归, 子协程结束时直接切换回等待者
+CoTask<long> chain(long n) {
+    if (n == 0) co_return 0;
+    co_return 1 + co_await chain(n - 1);
+}
+
+CoTask<> fail(ThreadPool& pool) {
+    co_await schedule(pool);
+    throw std::runtime_error("boom");
+}
+
+// 只能移动的返回值
+CoTask<std::unique_ptr<std::string>> make(ThreadPool& pool) {
+    co_await schedule(pool);
+    co_return std::make_unique<std::string>("coroutine");
+}
+
+// schedule 之后在工作线程中执行
+CoTask<bool> onWorker(ThreadPool& pool, pthread_t caller) {
+    co_await schedule(pool);
+    co_return !pthread_equal(pthread_self(), caller);
+}
+
+int main() {
+    ThreadPool pool(4);
+
+    assert(syncWait(fan(pool, 10000)) == 9999L * 10000L);
+    assert(syncWait(chain(10000)) == 10000);
+    assert(*syncWait(make(pool)) == "coroutine");
+    assert(syncWait(onWorker(pool, pthread_self())));
+
+    // 异常在 syncWait 中重新抛出
+    bool thrown = false;
+    try {
+        syncWait(fail(pool));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // 没有启动的协程直接销毁
+    { CoTask<long> unused = leaf(pool, 1); }
+
+    // 在工作线程中 syncWait 时帮忙执行排队的任务, 单线程的线程池也不会死锁
+    ThreadPool single(1);
+    assert(single.submit([&single] { return syncWait(fan(single, 100)); }).get() == 99L * 100L);
+
+    // 线程池停止后 schedule 在当前线程继续执行
+    single.shutdown();
+    assert(syncWait(leaf(single, 21)) == 42);
+
+    pool.shutdown();
+    printf("coroutine ok\n");
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "thread_pool.h"
+
+// 轮询线程数直到满足 done, 最多等 1 秒, 返回最后看到的线程数
+template <typename Done>
+static int waitThreads(ThreadPool& pool, Done done) {
+    uint64_t deadline = ThreadPool::nowNs() + 1000000000;
+    int n = pool.getThreadNum();
+    while (!done(n) && ThreadPool::nowNs() < deadline) {
+        usleep(1000);
+        n = pool.getThreadNum();
+    }
+    return n;
+}
+
+int main() {
+    // 1 到 8 个线程, 空闲 50 毫秒退出
+    ThreadPool pool(1, 8, 50);
+    assert(pool.getThreadNum() == 1);
+
+    // 任务积压时增加线程, 不超过上限
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 200; i++) {
+        pool.submit([&] {
+            usleep(2000);
+            ran++;
+        });
+    }
+    int peak = waitThreads(pool, [](int n) { return n > 1; });
+    printf("peak %d\n", peak);
+    assert(peak > 1 && peak <= 8);
+    pool.waitIdle();
+    assert(ran == 200);
+
+    // 空闲超时后退回到下限
+    assert(waitThreads(pool, [](int n) { return n == 1; }) == 1);
+
+    // 再次积压时重新增加
+    for (int i = 0; i < 100; i++) {
+        pool.submit([&] {
+            usleep(2000);
+            ran++;
+        });
+    }
+    assert(waitThreads(pool, [](int n) { return n > 1; }) > 1);
+    pool.waitIdle();
+    assert(ran == 300);
+
+    // 不积压时不增加线程
+    assert(waitThreads(pool, [](int n) { return n == 1; }) == 1);
+    for (int i = 0; i < 20; i++) {
+        pool.submit([&] { ran++; }).get();
+        usleep(1000);
+    }
+    assert(pool.getThreadNum() == 1);
+
+    // 已经因空闲退出的线程也能回收
+    assert(pool.shutdown() == 0 && ran == 320);
+
+    printf("elastic ok\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "thread_pool.h"
+
+// 进程用掉的 CPU 时间 (纳秒)
+static uint64_t cpuTime() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t(usage.ru_utime.tv_sec) + uint64_t(usage.ru_stime.tv_sec)) * 1000000000 +
+           (uint64_t(usage.ru_utime.tv_usec) + uint64_t(usage.ru_stime.tv_usec)) * 1000;
+}
+
+struct Producer {
+    ThreadPool* pool;
+    std::atomic<long>* ran;
+};
+
+// 一阵一阵地提交, 中间停顿让线程睡下去, 检查唤醒不会丢
+void* produce(void* p) {
+    Producer* prod = static_cast<Producer*>(p);
+    for (int burst = 0; burst < 50; burst++) {
+        for (int i = 0; i < 200; i++) prod->pool->submit([prod] { (*prod->ran)++; });
+        usleep(1000);
+    }
+    return nullptr;
+}
+
+int main() {
+    ThreadPool pool(4);
+
+    // 空闲的线程自旋一小会儿后在 futex 上睡眠, 不占 CPU
+    // 每 100 毫秒量一次, 1 秒之内总有一段几乎不用 CPU (机器很忙时单次测量可能偏大)
+    pool.submit([] {}).get();
+    uint64_t deadline = ThreadPool::nowNs() + 1000000000;
+    uint64_t used;
+    do {
+        uint64_t before = cpuTime();
+        usleep(100000);
+        used = cpuTime() - before;
+    } while (used >= 10000000 && ThreadPool::nowNs() < deadline);
+    printf("cpu while idle: %.2fms\n", used / 1e6);
+    assert(used < 10000000);
+
+    // 一问一答: 每次提交都可能遇到正在自旋或已经睡下的线程
+    for (int i = 0; i < 10000; i++) assert(pool.submit([i] { return i; }).get() == i);
+
+    // 多个生产者间歇地提交, 所有任务都被执行
+    std::atomic<long> ran(0);
+    Producer prod = {&pool, &ran};
+    pthread_t threads[4];
+    for (auto& t : threads) pthread_create(&t, nullptr, produce, &prod);
+    for (auto& t : threads) pthread_join(t, nullptr);
+    assert(pool.waitIdle() == 0 && ran == 4 * 50 * 200);
+
+    PoolMetrics m = pool.getMetrics();
+    uint64_t wakeups = 0;
+    for (auto& w : m.workers) wakeups += w.wakeups;
+    printf("wakeups: %lu\n", (unsigned long)wakeups);
+    assert(wakeups > 0);
+
+    // 停止时睡眠中的线程都能被叫醒退出
+    usleep(50000);
+    assert(pool.shutdown() == 0);
+    printf("idle ok\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 忙等 us 微秒
+struct Work : Task {
+    int us = 200;
+    void run() override {
+        uint64_t start = ThreadPool::nowNs();
+        while (ThreadPool::nowNs() - start < uint64_t(us) * 1000) {
+        }
+    }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+static uint64_t totalTasks(const PoolMetrics& m) {
+    uint64_t n = 0;
+    for (auto& w : m.workers) n += w.tasks;
+    return n;
+}
+
+int main() {
+    // 桶的上界覆盖桶里的值, 并且比前一个桶的上界大
+    for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+        size_t b = HistogramSnapshot::bucketOf(v);
+        assert(HistogramSnapshot::bucketHigh(b) >= v);
+        assert(b == 0 || HistogramSnapshot::bucketHigh(b - 1) < v);
+    }
+
+    ThreadPool pool(2);
+    std::vector<Work> tasks(1000);
+
+    // 任务数一直记录, 排队时间和执行时间只在打开后记录
+    for (auto& t : tasks) pool.addTask(&t);
+    pool.waitIdle();
+    PoolMetrics m = pool.getMetrics();
+    assert(totalTasks(m) == 1000 && m.run_time.count == 0 && m.queue_wait.count == 0);
+    assert(m.workers.size() == 2 && m.live_threads == 2);
+
+    pool.enableMetrics(true);
+    for (auto& t : tasks) pool.addTask(&t);
+    pool.waitIdle();
+    m = pool.getMetrics();
+    assert(totalTasks(m) == 2000);
+    assert(m.run_time.count == 1000 && m.queue_wait.count == 1000);
+    assert(m.run_time.percentile(50) >= 200000 && m.run_time.max >= m.run_time.percentile(99));
+    assert(m.run_time.sum >= 1000 * 200000ull);
+    for (auto& w : m.workers) assert(w.running && w.busy_ns > 0);
+
+    // 关闭后不再记录
+    pool.enableMetrics(false);
+    for (auto& t : tasks) pool.addTask(&t);
+    pool.waitIdle();
+    assert(pool.getMetrics().run_time.count == 1000);
+
+    // 排队的任务数
+    std::atomic<int> go(0);
+    Gate gates[2];
+    for (auto& g : gates) {
+        g.go = &go;
+        pool.addTask(&g);
+    }
+    while (pool.getTaskSize() != 0) usleep(100);
+    for (int i = 0; i < 10; i++) pool.addTask(&tasks[i]);
+    assert(pool.getMetrics().queued == 10);
+    go = 1;
+    pool.waitIdle();
+
+    // Prometheus 文本格式
+    std::string text = pool.getMetrics().toText("demo");
+    assert(text.find("# TYPE demo_tasks_total counter") != std::string::npos);
+    assert(text.find("demo_tasks_total{worker=\"0\"}") != std::string::npos);
+    assert(text.find("# TYPE demo_run_seconds summary") != std::string::npos);
+    assert(text.find("demo_run_seconds_count 1000") != std::string::npos);
+
+    pool.shutdown();
+    printf("metrics ok\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include "mpmc_queue.h"
+#include "thread_pool.h"
+
+const int producers = 4, per_producer = 100000;
+
+struct Shared {
+    MPMCQueue<int>* queue;
+    std::vector<int>* items;
+    std::vector<std::atomic<int>>* taken;
+    std::atomic<int>* next;     // 下一个生产者的编号
+    std::atomic<long>* popped;
+};
+
+// 队列满时让出 CPU 再重试
+void* produce(void* p) {
+    Shared* s = static_cast<Shared*>(p);
+    int id = (*s->next)++;
+    for (int i = 0; i < per_producer; i++) {
+        while (!s->queue->push(&(*s->items)[id * per_producer + i])) {
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+// 单个和批量出队交替使用
+void* consume(void* p) {
+    Shared* s = static_cast<Shared*>(p);
+    int* batch[8];
+    while (s->popped->load() < long(producers) * per_producer) {
+        if (int* x = s->queue->pop()) {
+            (*s->taken)[*x]++;
+            (*s->popped)++;
+        }
+        size_t n = s->queue->pop(batch, 8);
+        for (size_t i = 0; i < n; i++) (*s->taken)[*batch[i]]++;
+        (*s->popped) += long(n);
+        if (n == 0) {
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+struct Count : Task {
+    std::atomic<int>* ran;
+    pthread_t* runner;
+    void run() override {
+        *runner = pthread_self();
+        (*ran)++;
+    }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+int main() {
+    // 容量向上取整到 2 的幂, 满了 push 返回 false, 空了 pop 返回 nullptr, 先进先出
+    {
+        MPMCQueue<int> queue(5);
+        assert(queue.capacity() == 8);
+        std::vector<int> v(10);
+        for (int i = 0; i < 8; i++) {
+            v[i] = i;
+            assert(queue.push(&v[i]));
+        }
+        assert(!queue.push(&v[8]) && queue.size() == 8);
+        for (int i = 0; i < 8; i++) assert(*queue.pop() == i);
+        assert(queue.pop() == nullptr && queue.empty());
+
+        // 批量入队只放得下空闲的部分
+        int* items[10];
+        for (int i = 0; i < 10; i++) items[i] = &v[i];
+        assert(queue.push(items, 10) == 8 && queue.push(items, 10) == 0);
+        int* out[10];
+        assert(queue.pop(out, 3) == 3 && *out[0] == 0 && *out[2] == 2);
+        assert(queue.pop(out, 10) == 5 && *out[4] == 7);
+        assert(queue.pop(out, 10) == 0);
+    }
+
+    // 多个生产者和消费者: 每个元素恰好被取走一次
+    {
+        MPMCQueue<int> queue(64);
+        std::vector<int> items(producers * per_producer);
+        std::vector<std::atomic<int>> taken(items.size());
+        for (size_t i = 0; i < items.size(); i++) items[i] = int(i);
+        std::atomic<int> next(0);
+        std::atomic<long> popped(0);
+        Shared shared = {&queue, &items, &taken, &next, &popped};
+        pthread_t threads[producers + 3];
+        for (int i = 0; i < producers; i++) pthread_create(&threads[i], nullptr, produce, &shared);
+        for (int i = producers; i < producers + 3; i++) pthread_create(&threads[i], nullptr, consume, &shared);
+        for (auto& t : threads) pthread_join(t, nullptr);
+        for (auto& t : taken) assert(t == 1);
+    }
+
+    // 注入队列满时的三种处理方式
+    for (int policy = 0; policy < 3; policy++) {
+        ThreadPool pool(1, 4, OverflowPolicy(policy));
+        std::atomic<int> go(0), ran(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        while (pool.getTaskSize() != 0) usleep(100);
+
+        // Block 策略的生产者会一直等到 gate 放行
+        pthread_t opener;
+        pthread_create(&opener, nullptr, [](void* p) -> void* {
+            usleep(50000);
+            *static_cast<std::atomic<int>*>(p) = 1;
+            return nullptr;
+        }, &go);
+
+        std::vector<Count> tasks(20);
+        std::vector<pthread_t> runners(20);
+        int accepted = 0;
+        for (int i = 0; i < 20; i++) {
+            tasks[i].ran = &ran;
+            tasks[i].runner = &runners[i];
+            accepted += pool.addTask(&tasks[i]) == 0;
+        }
+        pthread_join(opener, nullptr);
+        pool.waitIdle();
+        if (OverflowPolicy(policy) == OverflowPolicy::Fail) {
+            assert(accepted == 4 && ran == 4);
+        } else {
+            assert(accepted == 20 && ran == 20);
+        }
+        // CallerRuns: 放不下的任务在调用线程中执行
+        if (OverflowPolicy(policy) == OverflowPolicy::CallerRuns) {
+            assert(pthread_equal(runners[19], pthread_self()));
+        }
+        pool.shutdown();
+    }
+
+    printf("mpmc_queue ok\n");
+    return 0;
+}
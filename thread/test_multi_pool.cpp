@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 记录执行它的线程
+struct Where : Task {
+    std::mutex* lock;
+    std::set<pthread_t>* threads;
+    std::atomic<int>* ran;
+    void run() override {
+        {
+            std::lock_guard<std::mutex> guard(*lock);
+            threads->insert(pthread_self());
+        }
+        (*ran)++;
+        usleep(100);
+    }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+int main() {
+    // 两个线程池各自的任务只在各自的线程上执行
+    {
+        ThreadPool a(3), b(2);
+        std::mutex lock;
+        std::set<pthread_t> a_threads, b_threads;
+        std::atomic<int> ran(0);
+        std::vector<Where> tasks(400);
+        for (int i = 0; i < 400; i++) {
+            tasks[i].lock = &lock;
+            tasks[i].threads = i % 2 ? &a_threads : &b_threads;
+            tasks[i].ran = &ran;
+            (i % 2 ? a : b).addTask(&tasks[i]);
+        }
+        assert(a.waitIdle() == 0 && b.waitIdle() == 0 && ran == 400);
+        assert(a_threads.size() <= 3 && b_threads.size() <= 2);
+        for (pthread_t t : a_threads) assert(b_threads.count(t) == 0);
+
+        // 停止一个线程池不影响另一个
+        a.shutdown();
+        assert(a.addTask(&tasks[0]) == -1);
+        assert(b.submit([] { return 3; }).get() == 3);
+        b.shutdown();
+    }
+
+    // 反复创建和销毁, 每次都是全新的状态
+    for (int r = 0; r < 100; r++) {
+        ThreadPool pool(2);
+        assert(pool.getTaskSize() == 0 && pool.getThreadNum() == 2);
+        assert(pool.submit([r] { return r; }).get() == r);
+    }
+
+    // 不是工作线程时 helpPendingTask 返回 false, runPendingTask 执行指定线程池中排队的任务
+    {
+        ThreadPool pool(1);
+        std::atomic<int> go(0), ran(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        while (pool.getTaskSize() != 0) usleep(100);
+        Future<void> f = pool.submit([&] { ran++; });
+        assert(!helpPendingTask());
+        assert(pool.runPendingTask() && ran == 1 && f.isReady());
+        assert(!pool.runPendingTask());
+        go = 1;
+        pool.shutdown();
+        // 停止之后没有可执行的任务
+        assert(!pool.runPendingTask());
+    }
+
+    printf("multi_pool ok\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "../stl/vector"
+#include "parallel.h"
+
+int main() {
+    ThreadPool pool(4);
+
+    // stl 的 vector: 迭代器是指针
+    vector<long> v;
+    for (long i = 0; i < 1000000; i++) v.push_back(i);
+
+    parallel_for(pool, v.begin(), v.end(), [](long* f, long* l) {
+        for (; f != l; ++f) *f *= 2;
+    });
+    for (long i = 0; i < 1000000; i++) assert(v[i] == 2 * i);
+
+    long sum = parallel_reduce(
+        pool, v.begin(), v.end(), 0L,
+        [](long* f, long* l) {
+            long s = 0;
+            for (; f != l; ++f) s += *f;
+            return s;
+        },
+        [](long a, long b) { return a + b; });
+    assert(sum == 999999L * 1000000L);
+
+    // 合并按块的顺序进行, 不满足交换律的 combine 结果也是确定的
+    vector<int> digits;
+    for (int i = 0; i < 1000; i++) digits.push_back(i % 10);
+    std::string joined = parallel_reduce(
+        pool, digits.begin(), digits.end(), 7, std::string(),
+        [](int* f, int* l) {
+            std::string s;
+            for (; f != l; ++f) s += char('0' + *f);
+            return s;
+        },
+        [](const std::string& a, const std::string& b) { return a + b; });
+    for (int i = 0; i < 1000; i++) assert(joined[i] == char('0' + i % 10));
+
+    // 排序: 比块大的, 比块小的, 自定义比较
+    std::mt19937 gen(1);
+    for (size_t n : {size_t(0), size_t(1), size_t(100), size_t(100000), size_t(1000003)}) {
+        vector<long> w;
+        for (size_t i = 0; i < n; i++) w.push_back(long(gen() % 1000));
+        parallel_sort(pool, w.begin(), w.end());
+        assert(std::is_sorted(w.begin(), w.end()));
+        parallel_sort(pool, w.begin(), w.end(), std::greater<long>());
+        assert(std::is_sorted(w.begin(), w.end(), std::greater<long>()));
+    }
+
+    // 整数下标, grain 为 1, 空区间, 嵌套调用
+    std::atomic<long> count(0);
+    parallel_for(pool, 0, 1000, 1, [&](int f, int l) { count += l - f; });
+    assert(count == 1000);
+    count = 0;
+    parallel_for(pool, 5, 5, [&](int f, int l) { count += l - f; });
+    assert(count == 0 && parallel_reduce(pool, 5, 5, 42L, [](int, int) { return 1L; }, std::plus<long>()) == 42);
+    parallel_for(pool, 0, 100, 1, [&](int, int) {
+        parallel_for(pool, 0, 100, 1, [&](int f, int l) { count += l - f; });
+    });
+    assert(count == 10000);
+
+    // 块抛出异常: 等所有已提交的块结束后在调用线程重新抛出, 之后的块不再处理
+    for (int round = 0; round < 100; round++) {
+        std::atomic<int> running(0);
+        count = 0;
+        bool thrown = false;
+        try {
+            parallel_for(pool, 0, 1000, 1, [&](int f, int) {
+                running++;
+                count++;
+                if (f == round * 7 % 1000) {
+                    running--;
+                    throw std::runtime_error("chunk " + std::to_string(f));
+                }
+                usleep(10);
+                running--;
+            });
+        } catch (const std::runtime_error& e) {
+            thrown = std::string(e.what()) == "chunk " + std::to_string(round * 7 % 1000);
+        }
+        assert(thrown && running == 0 && count <= 1000);
+    }
+    // 调用线程自己执行的第一块抛出异常
+    bool thrown = false;
+    try {
+        parallel_reduce(
+            pool, 0, 100, 1, 0L,
+            [](int f, int) -> long {
+                if (f == 0) throw 1;
+                return 1;
+            },
+            std::plus<long>());
+    } catch (int) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // 注入队列满了 (Fail 策略), 被拒绝的块在当前线程执行
+    ThreadPool small(2, 2, OverflowPolicy::Fail);
+    count = 0;
+    parallel_for(small, 0, 100000, 1, [&](int f, int l) { count += l - f; });
+    assert(count == 100000);
+
+    small.shutdown();
+    pool.shutdown();
+    printf("parallel ok\n");
+    return 0;
+}
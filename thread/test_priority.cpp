@@ -0,0 +1,129 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 只有一个工作线程, 执行顺序就是取任务的顺序
+static std::vector<int> order;
+
+struct Mark : Task {
+    int id;
+    void run() override { order.push_back(id); }
+};
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+// 不断提交新的高优先级任务
+struct Flood : Task {
+    ThreadPool* pool;
+    int left;
+    void run() override {
+        order.push_back(0);
+        if (--left > 0) pool->addTask(this, Priority::High);
+    }
+};
+
+static void hold(ThreadPool& pool, Gate& gate, std::atomic<int>& go) {
+    go = 0;
+    gate.go = &go;
+    pool.addTask(&gate);
+    while (pool.getTaskSize() != 0) usleep(100);
+}
+
+static size_t position(int id) { return std::find(order.begin(), order.end(), id) - order.begin(); }
+
+int main() {
+    ThreadPool pool(1);
+    Gate gate;
+    std::atomic<int> go(0);
+
+    // 截止时间任务最先, 按截止时间排列; 然后是高, 普通, 低优先级
+    {
+        hold(pool, gate, go);
+        std::vector<Mark> tasks(20);
+        for (int i = 0; i < 20; i++) tasks[i].id = i;
+        for (int i = 0; i < 5; i++) {
+            pool.addTask(&tasks[i], Priority::Low);
+            pool.addTask(&tasks[5 + i], Priority::Normal);
+            pool.addTask(&tasks[10 + i], Priority::High);
+            pool.addDeadlineTask(&tasks[15 + i], 1000 - i);
+        }
+        order.clear();
+        go = 1;
+        pool.waitIdle();
+        assert(order.size() == 20);
+        for (int i = 19; i > 15; i--) assert(position(i) < position(i - 1));
+        for (int d = 15; d < 20; d++) {
+            for (int h = 10; h < 15; h++) assert(position(d) < position(h));
+        }
+        for (int h = 10; h < 15; h++) {
+            for (int n = 5; n < 10; n++) assert(position(h) < position(n));
+        }
+        // 低优先级只在每 16 次取任务中防饿死的那一次插到前面 (连同同一批取出的任务)
+        for (int l = 0; l < 5; l++) assert(position(5) < position(l));
+    }
+
+    // 高优先级任务源源不断时低优先级任务也能执行
+    {
+        hold(pool, gate, go);
+        Mark low;
+        low.id = 1;
+        Flood flood;
+        flood.pool = &pool;
+        flood.left = 1000;
+        pool.addTask(&low, Priority::Low);
+        pool.addTask(&flood, Priority::High);
+        order.clear();
+        go = 1;
+        pool.waitIdle();
+        assert(order.size() == 1001 && position(1) < 100);
+    }
+
+    // 大量随机截止时间: 严格按截止时间执行
+    {
+        hold(pool, gate, go);
+        std::vector<Mark> tasks(20000);
+        unsigned seed = 1;
+        for (auto& t : tasks) {
+            t.id = rand_r(&seed) % 5000;
+            pool.addDeadlineTask(&t, uint64_t(t.id));
+        }
+        order.clear();
+        go = 1;
+        pool.waitIdle();
+        assert(order.size() == tasks.size() && std::is_sorted(order.begin(), order.end()));
+    }
+
+    // shutdownNow 返回截止时间队列中的任务
+    {
+        hold(pool, gate, go);
+        std::vector<Mark> tasks(100);
+        for (auto& t : tasks) pool.addDeadlineTask(&t, ThreadPool::nowNs());
+        pthread_t opener;
+        pthread_create(&opener, nullptr, [](void* p) -> void* {
+            usleep(20000);
+            *static_cast<std::atomic<int>*>(p) = 1;
+            return nullptr;
+        }, &go);
+        std::vector<Task*> unrun = pool.shutdownNow();
+        pthread_join(opener, nullptr);
+        assert(unrun.size() == 100);
+        assert(pool.addDeadlineTask(&tasks[0], 0) == -1);
+    }
+
+    printf("priority ok\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "coroutine.h"
+#include "parallel.h"
+#include "thread_pool.h"
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+struct Count : Task {
+    std::atomic<int>* ran;
+    std::atomic<int>* dropped;
+    void run() override { (*ran)++; }
+    void onCancel() override { (*dropped)++; }
+};
+
+// 提交子任务的任务 shutdown 要等子任务也执行完
+struct Spawner : Task {
+    ThreadPool* pool;
+    Count* children;
+    void run() override {
+        for (int i = 0; i < 10; i++) pool->addTask(&children[i]);
+    }
+};
+
+CoTask<int> resumeOn(ThreadPool& pool) {
+    co_await schedule(pool);
+    co_return 1;
+}
+
+int main() {
+    // waitIdle 等到所有任务 (包括子任务) 执行完, shutdown 执行完排队的任务再停止
+    {
+        ThreadPool pool(4);
+        std::atomic<int> ran(0), dropped(0);
+        std::vector<Count> children(1000);
+        std::vector<Spawner> spawners(100);
+        for (int i = 0; i < 100; i++) {
+            for (int j = 0; j < 10; j++) {
+                children[i * 10 + j].ran = &ran;
+                children[i * 10 + j].dropped = &dropped;
+            }
+            spawners[i].pool = &pool;
+            spawners[i].children = &children[i * 10];
+            pool.addTask(&spawners[i]);
+        }
+        assert(pool.waitIdle() == 0 && ran == 1000);
+
+        for (int i = 0; i < 100; i++) pool.addTask(&spawners[i]);
+        assert(pool.shutdown() == 0 && ran == 2000 && dropped == 0);
+        // 停止之后不再接受任务
+        assert(pool.addTask(&children[0]) == -1 && !pool.submit([] {}).valid());
+        assert(pool.shutdown() == -1 && pool.stopAll() == -1);
+    }
+
+    // shutdownNow 只返回调用者提交的任务, 内部的任务被取消, 等待它们的一方都能返回
+    {
+        ThreadPool pool(1);
+        std::atomic<int> go(0), ran(0), dropped(0);
+        Gate gate;
+        gate.go = &go;
+        pool.addTask(&gate);
+        while (pool.getTaskSize() != 0) usleep(100);
+
+        std::vector<Count> mine(20);
+        for (auto& c : mine) {
+            c.ran = &ran;
+            c.dropped = &dropped;
+            pool.addTask(&c);
+        }
+        std::vector<Future<int>> futures;
+        for (int i = 0; i < 20; i++) futures.push_back(pool.submit([i] { return i; }));
+        TaskGroup group(pool);
+        for (int i = 0; i < 20; i++) group.run([&] { ran++; });
+
+        // 协程在另一个线程中等待, 它的恢复任务排在队列里
+        std::atomic<int> co_result(0);
+        pthread_t waiter;
+        struct Arg {
+            ThreadPool* pool;
+            std::atomic<int>* result;
+        } arg{&pool, &co_result};
+        pthread_create(&waiter, nullptr, [](void* p) -> void* {
+            Arg* a = static_cast<Arg*>(p);
+            try {
+                *a->result = syncWait(resumeOn(*a->pool));
+            } catch (const TaskCancelled&) {
+                *a->result = -1;
+            }
+            return nullptr;
+        }, &arg);
+        while (pool.getTaskSize() < 61) usleep(100);
+
+        // shutdownNow 先设置退出标志再等线程结束, gate 过一会儿才放行, 线程放行后直接退出
+        pthread_t opener;
+        pthread_create(&opener, nullptr, [](void* p) -> void* {
+            usleep(50000);
+            *static_cast<std::atomic<int>*>(p) = 1;
+            return nullptr;
+        }, &go);
+        std::vector<Task*> unrun = pool.shutdownNow();
+        pthread_join(opener, nullptr);
+        assert(unrun.size() == 20 && ran == 0 && dropped == 0);
+        std::sort(unrun.begin(), unrun.end());
+        for (size_t i = 0; i < unrun.size(); i++) assert(unrun[i] == &mine[i]);
+
+        int cancelled = 0;
+        for (auto& f : futures) {
+            try {
+                f.get();
+            } catch (const TaskCancelled&) {
+                cancelled++;
+            }
+        }
+        assert(cancelled == 20);
+        group.wait();
+        pthread_join(waiter, nullptr);
+        assert(co_result == -1);
+        assert(pool.waitIdle() == 0);
+    }
+
+    // 析构时丢弃的任务同样经过 onCancel
+    {
+        std::atomic<int> go(0), ran(0), dropped(0);
+        Gate gate;
+        gate.go = &go;
+        std::vector<Count> mine(10);
+        Future<void> f;
+        {
+            ThreadPool pool(1);
+            pool.addTask(&gate);
+            for (auto& c : mine) {
+                c.ran = &ran;
+                c.dropped = &dropped;
+                pool.addTask(&c);
+            }
+            f = pool.submit([] {});
+            go = 1;
+        }
+        assert(ran + dropped == 10);
+        bool thrown = false;
+        try {
+            f.get();
+        } catch (const TaskCancelled&) {
+            thrown = true;
+        }
+        // 析构前线程可能已经执行了它
+        (void)thrown;
+    }
+
+    printf("shutdown ok\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 占住工作线程, 直到 go 被置位
+struct Gate : Task {
+    std::atomic<int>* go;
+    void run() override {
+        while (!go->load()) usleep(100);
+    }
+};
+
+// 对齐要求超过 max_align_t 的可调用对象
+struct alignas(64) Aligned {
+    char data[64];
+    uintptr_t operator()() const { return uintptr_t(this); }
+};
+
+int main() {
+    ThreadPool pool(4);
+
+    // 参数按值保存, 结果从 Future 取出
+    {
+        std::vector<Future<long>> futures;
+        for (long i = 0; i < 10000; i++) futures.push_back(pool.submit([](long a, long b) { return a * b; }, i, 2L));
+        long sum = 0;
+        for (auto& f : futures) sum += f.get();
+        assert(sum == 9999L * 10000L);
+    }
+
+    // 没有返回值, 只能移动的参数和返回值, 捕获的大对象
+    {
+        std::atomic<int> ran(0);
+        Future<void> v = pool.submit([&] { ran++; });
+        v.get();
+        assert(ran == 1 && !v.valid());
+
+        auto p = std::make_unique<int>(5);
+        Future<std::unique_ptr<int>> u =
+            pool.submit([](std::unique_ptr<int> q) { return std::make_unique<int>(*q * 2); }, std::move(p));
+        assert(*u.get() == 10);
+
+        std::string big(1000, 'x');
+        Future<size_t> s = pool.submit([big](const std::string& t) { return big.size() + t.size(); }, std::string("ab"));
+        assert(s.get() == 1002);
+    }
+
+    // 任务抛出的异常在 get 中重新抛出
+    {
+        Future<int> f = pool.submit([]() -> int { throw std::runtime_error("boom"); });
+        bool thrown = false;
+        try {
+            f.get();
+        } catch (const std::runtime_error& e) {
+            thrown = std::string(e.what()) == "boom";
+        }
+        assert(thrown);
+    }
+
+    // 不取结果直接丢弃 Future, 节点在任务执行完后释放
+    {
+        std::atomic<int> ran(0);
+        for (int i = 0; i < 1000; i++) pool.submit([&] { ran++; });
+        pool.waitIdle();
+        assert(ran == 1000);
+    }
+
+    // Future 可以移动, wait 之后 isReady
+    {
+        Future<int> a = pool.submit([] { return 1; });
+        Future<int> b(std::move(a));
+        assert(!a.valid() && b.valid());
+        a = std::move(b);
+        a.wait();
+        assert(a.isReady() && a.get() == 1);
+    }
+
+    // 工作线程中等待其他 Future 时帮忙执行排队的任务, 单线程的线程池也不会死锁
+    {
+        ThreadPool single(1);
+        Future<int> outer = single.submit([&single] {
+            Future<int> inner = single.submit([] { return 41; });
+            return inner.get() + 1;
+        });
+        assert(outer.get() == 42);
+        single.shutdown();
+    }
+
+    // 被拒绝 (Fail 策略队列满, 或线程池已停止) 时 Future 无效
+    {
+        ThreadPool small(1, 2, OverflowPolicy::Fail);
+        std::atomic<int> go(0);
+        Gate gate;
+        gate.go = &go;
+        small.addTask(&gate);
+        while (small.getTaskSize() != 0) usleep(100);
+        int rejected = 0;
+        std::vector<Future<int>> futures;
+        for (int i = 0; i < 10; i++) {
+            Future<int> f = small.submit([i] { return i; });
+            if (f.valid()) {
+                futures.push_back(std::move(f));
+            } else {
+                rejected++;
+            }
+        }
+        assert(rejected > 0 && futures.size() == size_t(10 - rejected));
+        go = 1;
+        for (auto& f : futures) f.get();
+        small.shutdown();
+        assert(!small.submit([] { return 0; }).valid());
+    }
+
+    // 节点按可调用对象的对齐要求分配
+    {
+        std::vector<Future<uintptr_t>> futures;
+        for (int i = 0; i < 100; i++) futures.push_back(pool.submit(Aligned()));
+        for (auto& f : futures) assert(f.get() % 64 == 0);
+    }
+
+    pool.shutdown();
+    printf("submit ok\n");
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <atomic>
+
+#include "task_graph.h"
+
+int main() {
+    ThreadPool pool(4);
+
+    // 菱形: a 在 b c 之前, d 在 b c 之后
+    TaskGraph g;
+    std::atomic<int> order(0);
+    int a_at = -1, b_at = -1, c_at = -1, d_at = -1;
+    TaskGraph::Node* a = g.emplace([&] { a_at = order++; });
+    TaskGraph::Node* b = g.emplace([&] { b_at = order++; });
+    TaskGraph::Node* c = g.emplace([&] { c_at = order++; });
+    TaskGraph::Node* d = g.emplace([&] { d_at = order++; });
+    a->precede(b);
+    a->precede(c);
+    d->succeed(b);
+    d->succeed(c);
+
+    // 很长的链 延续在循环中执行, 不会撑爆栈
+    long sum = 0;
+    TaskGraph::Node* prev = d;
+    for (int i = 0; i < 100000; i++) {
+        TaskGraph::Node* n = g.emplace([&] { sum++; });
+        prev->precede(n);
+        prev = n;
+    }
+
+    // 同一个图可以反复运行
+    for (int r = 0; r < 10; r++) {
+        order = 0;
+        sum = 0;
+        assert(g.run(pool) == 0);
+        assert(a_at == 0 && d_at == 3 && b_at > 0 && b_at < 3 && c_at > 0 && c_at < 3);
+        assert(sum == 100000);
+    }
+
+    // 从源点可达的环: 一个节点都不执行, 直接返回 -1
+    TaskGraph cyclic;
+    std::atomic<int> ran(0);
+    TaskGraph::Node* s = cyclic.emplace([&] { ran++; });
+    TaskGraph::Node* x = cyclic.emplace([&] { ran++; });
+    TaskGraph::Node* y = cyclic.emplace([&] { ran++; });
+    TaskGraph::Node* z = cyclic.emplace([&] { ran++; });
+    s->precede(x);
+    x->precede(y);
+    y->precede(z);
+    z->precede(x);
+    assert(cyclic.run(pool) == -1 && ran == 0);
+
+    // 没有源点的环
+    TaskGraph ring;
+    TaskGraph::Node* p = ring.emplace([&] { ran++; });
+    TaskGraph::Node* q = ring.emplace([&] { ran++; });
+    p->precede(q);
+    q->precede(p);
+    assert(ring.run(pool) == -1 && ran == 0);
+
+    // 自环
+    TaskGraph self;
+    TaskGraph::Node* o = self.emplace([&] { ran++; });
+    o->precede(o);
+    assert(self.run(pool) == -1 && ran == 0);
+
+    // 空图
+    TaskGraph empty;
+    assert(empty.run(pool) == 0);
+
+    // 节点抛出异常: 它的后继不再执行, run 在其他节点结束后重新抛出, 图可以再次运行
+    {
+        TaskGraph g;
+        std::atomic<int> done(0);
+        bool fail = true;
+        TaskGraph::Node* src = g.emplace([&] { done++; });
+        TaskGraph::Node* bad = g.emplace([&] {
+            if (fail) throw 42;
+            done++;
+        });
+        TaskGraph::Node* after = g.emplace([&] { done += 100; });
+        src->precede(bad);
+        bad->precede(after);
+        for (int i = 0; i < 100; i++) src->precede(g.emplace([&] { done++; }));
+        int caught = 0;
+        try {
+            g.run(pool);
+        } catch (int e) {
+            caught = e;
+        }
+        assert(caught == 42 && done <= 1 + 100);
+        fail = false;
+        done = 0;
+        assert(g.run(pool) == 0 && done == 1 + 1 + 100 + 100);
+    }
+
+    // Fail 策略的队列满了, 被拒绝的节点在当前线程执行
+    ThreadPool small(1, 1, OverflowPolicy::Fail);
+    TaskGraph wide;
+    std::atomic<int> leaves(0);
+    TaskGraph::Node* root = wide.emplace([] {});
+    for (int i = 0; i < 1000; i++) root->precede(wide.emplace([&] { leaves++; }));
+    assert(wide.run(small) == 0 && leaves == 1000);
+
+    pool.shutdown();
+    small.shutdown();
+    printf("task_graph ok\n");
+    return 0;
+}
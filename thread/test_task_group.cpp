@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "parallel.h"
+
+ThreadPool* pool;
+
+// 每一层都在工作线程中等待子任务, 等待时帮忙执行排队的任务, 两个线程也不会死锁
+long fib(int n) {
+    if (n < 2) return n;
+    long a, b;
+    TaskGroup group(*pool);
+    group.run([&] { a = fib(n - 1); });
+    b = fib(n - 2);
+    group.wait();
+    return a + b;
+}
+
+// 用 Future 实现的同一个递归, get 同样帮忙执行排队的任务
+long futureFib(int n) {
+    if (n < 2) return n;
+    Future<long> a = pool->submit(futureFib, n - 1);
+    long b = futureFib(n - 2);
+    return a.get() + b;
+}
+
+int main() {
+    ThreadPool two(2);
+    pool = &two;
+    assert(two.submit(fib, 22).get() == 17711);
+    assert(two.submit(futureFib, 18).get() == 2584);
+    // 在外部线程中等待也一样
+    assert(fib(20) == 6765);
+
+    // wait 之后可以继续使用, 析构时等待没有 wait 的任务
+    {
+        std::atomic<int> ran(0);
+        {
+            TaskGroup group(two);
+            for (int i = 0; i < 100; i++) group.run([&] { ran++; });
+            group.wait();
+            assert(ran == 100);
+            for (int i = 0; i < 100; i++) group.run([&] { ran++; });
+        }
+        assert(ran == 200);
+    }
+
+    // 截止时间到了以后还没开始的任务被丢弃, wait 照常返回
+    {
+        std::atomic<int> ran(0);
+        TaskGroup group(two);
+        group.setDeadline(ThreadPool::nowNs() + 20000000);
+        for (int i = 0; i < 1000; i++) {
+            group.run([&] {
+                ran++;
+                usleep(1000);
+            });
+        }
+        group.wait();
+        assert(group.isCancelled() && ran > 0 && ran < 1000);
+        // 取消之后 run 不再提交
+        group.run([&] { ran = -1; });
+        group.wait();
+        assert(ran != -1);
+    }
+
+    // 任务抛出异常: wait 等所有任务结束后重新抛出第一个, 之后组可以继续使用
+    {
+        std::atomic<int> ran(0);
+        TaskGroup group(two);
+        for (int i = 0; i < 1000; i++) {
+            group.run([&, i] {
+                usleep(10);
+                if (i == 10) throw i;
+                ran++;
+            });
+        }
+        bool thrown = false;
+        try {
+            group.wait();
+        } catch (int i) {
+            thrown = i == 10;
+        }
+        assert(thrown && ran < 1000);
+        ran = 0;
+        for (int i = 0; i < 100; i++) group.run([&] { ran++; });
+        group.wait();
+        assert(ran == 100);
+        // 没有 wait 就析构: 等任务结束, 不抛出
+        group.run([] { throw 1; });
+    }
+
+    // 注入队列满了 (Fail 策略), 被拒绝的任务在当前线程执行
+    {
+        ThreadPool small(1, 2, OverflowPolicy::Fail);
+        std::atomic<int> ran(0);
+        TaskGroup group(small);
+        for (int i = 0; i < 1000; i++) group.run([&] { ran++; });
+        group.wait();
+        assert(ran == 1000);
+        small.shutdown();
+    }
+
+    two.shutdown();
+    printf("task_group ok\n");
+    return 0;
+}
@@ -30,18 +30,11 @@ int main() {
         pool.addTask(&t);
     }
 
-    while (true) {
-        printf("there are still %lu tasks need to handle\n", pool.getTaskSize());
-        if (pool.getTaskSize() == 0) {
-            if (pool.stopAll() == -1) {
-                printf("thread pool destroy\n");
-                exit(0);
-            }
-        }
-
-        sleep(2);
-
-        printf("2 seconds later..\n");
-    }
+    printf("there are still %lu tasks need to handle\n", pool.getTaskSize());
+
+    // 等排队的任务全部执行完再停止线程池, 不需要轮询 getTaskSize
+    pool.shutdown();
+    printf("thread pool destroy\n");
+
     return 0;
 }
\ No newline at end of file
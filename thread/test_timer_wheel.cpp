@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+
+const uint64_t ms = 1000000;
+
+// 记录第一次执行的时间和执行次数
+struct Timed : Task {
+    uint64_t due = 0;
+    std::atomic<uint64_t> fired{0};
+    std::atomic<int> runs{0};
+    std::atomic<int> cancels{0};
+    void run() override {
+        if (fired == 0) fired = ThreadPool::nowNs();
+        runs++;
+    }
+    void onCancel() override { cancels++; }
+};
+
+static long contextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+}
+
+int main() {
+    ThreadPool pool(2);
+
+    // 随机的到期时间, 跨过第 0 层的好几圈; 取消的不执行, 其余的不早于到期时间执行
+    {
+        const int n = 2000;
+        std::vector<Timed> timers(n);
+        std::vector<uint64_t> ids(n);
+        srand(1);
+        for (int i = 0; i < n; i++) {
+            uint64_t delay = uint64_t(rand() % 800) * ms + rand() % ms;
+            timers[i].due = ThreadPool::nowNs() + delay;
+            ids[i] = pool.scheduleAfter(delay, &timers[i]);
+            assert(ids[i] != 0);
+        }
+        for (int i = 0; i < n; i += 7) assert(pool.cancelTimer(ids[i]) == 0);
+
+        Timed periodic;
+        uint64_t pid = pool.scheduleEvery(10 * ms, &periodic);
+        usleep(1000000);
+        assert(pool.cancelTimer(pid) == 0 && pool.cancelTimer(pid) == -1);
+        assert(periodic.runs >= 50 && periodic.runs <= 100);
+
+        uint64_t max_late = 0;
+        for (int i = 0; i < n; i++) {
+            assert(pool.cancelTimer(ids[i]) == -1);
+            if (i % 7 == 0) {
+                assert(timers[i].fired == 0);
+                continue;
+            }
+            assert(timers[i].fired >= timers[i].due);
+            max_late = std::max(max_late, timers[i].fired - timers[i].due);
+        }
+        printf("max late %.2fms\n", max_late / 1e6);
+        assert(max_late < 100 * ms);
+    }
+
+    // 只有远处的定时器时定时线程不会每一格都醒来
+    {
+        Timed far;
+        uint64_t id = pool.scheduleAfter(2000 * ms, &far);
+        usleep(10000);
+        long before = contextSwitches();
+        usleep(600000);
+        long switches = contextSwitches() - before;
+        printf("context switches in 600ms: %ld\n", switches);
+        assert(switches < 100);
+
+        // 定时线程睡着时加入更早到期的定时器, 它要被叫醒, 按时执行
+        Timed near;
+        near.due = ThreadPool::nowNs() + 20 * ms;
+        pool.scheduleAfter(20 * ms, &near);
+        usleep(200000);
+        assert(near.fired >= near.due && near.fired < near.due + 100 * ms);
+        assert(far.fired == 0 && pool.cancelTimer(id) == 0);
+    }
+
+    // shutdownNow 返回没有到期的定时器的任务, 之后不再接受定时任务
+    {
+        Timed a, b, x;
+        pool.scheduleAfter(100000 * ms, &a);
+        pool.scheduleAfter(10ull * 86400 * 1000 * ms, &b);
+        std::vector<Task*> unrun = pool.shutdownNow();
+        std::sort(unrun.begin(), unrun.end());
+        std::vector<Task*> expect = {&a, &b};
+        std::sort(expect.begin(), expect.end());
+        assert(unrun == expect);
+        assert(pool.scheduleAfter(1, &x) == 0 && pool.scheduleEvery(ms, &x) == 0);
+    }
+
+    // shutdown 等排队的任务执行完, 没有到期的定时器 (包括周期的) 不执行, 对它们的任务调用 onCancel
+    {
+        ThreadPool other(2);
+        Timed soon, later, every;
+        soon.due = ThreadPool::nowNs();
+        other.scheduleAfter(0, &soon);
+        other.scheduleAfter(100000 * ms, &later);
+        other.scheduleEvery(100000 * ms, &every);
+        while (soon.runs == 0) usleep(1000);
+        assert(other.shutdown() == 0);
+        assert(soon.runs == 1 && soon.cancels == 0);
+        assert(later.runs == 0 && later.cancels == 1);
+        assert(every.runs == 0 && every.cancels == 1);
+    }
+
+    printf("timer_wheel ok\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+struct Named : Task {
+    explicit Named(std::string& name) : Task(name) {}
+    void run() override {}
+};
+
+static std::string readFile(const char* path) {
+    std::string s;
+    FILE* f = fopen(path, "r");
+    assert(f);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+    fclose(f);
+    return s;
+}
+
+static size_t count(const std::string& s, const std::string& what) {
+    size_t n = 0;
+    for (size_t p = s.find(what); p != std::string::npos; p = s.find(what, p + 1)) n++;
+    return n;
+}
+
+int main() {
+    const char* path = "/tmp/test_trace.json";
+    ThreadPool pool(2);
+
+    // 没有在记录, 打不开的文件
+    assert(pool.stopTrace() == -1);
+    assert(pool.startTrace("/nonexistent/dir/trace.json") == -1);
+
+    // 每个任务一个提交, 开始和结束事件; 名称中的引号被转义
+    std::string name = "say \"hi\"";
+    std::vector<Named> tasks(1000, Named(name));
+    assert(pool.startTrace(path) == 0);
+    assert(pool.startTrace(path) == -1);
+    for (auto& t : tasks) pool.addTask(&t);
+    pool.waitIdle();
+    assert(pool.stopTrace() == 0);
+
+    std::string json = readFile(path);
+    assert(json.compare(0, 16, "{\"traceEvents\":[") == 0);
+    assert(json.compare(json.size() - 3, 3, "]}\n") == 0);
+    assert(count(json, "\"ph\":\"i\"") == 1000);
+    assert(count(json, "\"ph\":\"B\"") == 1000);
+    assert(count(json, "\"ph\":\"E\"") == 1000);
+    assert(count(json, "\"name\":\"say \\\"hi\\\"\"") == 2000);
+    assert(count(json, "\"thread_name\"") >= 2);
+
+    // 缓冲区太小时丢弃事件并计数, 文件照样完整
+    std::vector<Named> many(100000, Named(name));
+    assert(pool.startTrace(path, 4) == 0);
+    for (auto& t : many) pool.addTask(&t);
+    pool.waitIdle();
+    long dropped = pool.stopTrace();
+    printf("dropped %ld\n", dropped);
+    assert(dropped > 0);
+    json = readFile(path);
+    assert(json.compare(json.size() - 3, 3, "]}\n") == 0);
+    assert(count(json, "\"ph\":\"B\"") + count(json, "\"ph\":\"i\"") + count(json, "\"ph\":\"E\"") + size_t(dropped) ==
+           3 * many.size());
+
+    pool.shutdown();
+    unlink(path);
+    printf("trace ok\n");
+    return 0;
+}
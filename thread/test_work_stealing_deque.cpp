@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+#include "work_stealing_deque.h"
+
+const int items = 200000;
+
+struct Shared {
+    WorkStealingDeque<int>* deque;
+    std::vector<std::atomic<int>>* taken;
+    std::atomic<bool>* done;
+};
+
+// 窃取者一直偷到所有者结束并且队列已空
+void* thief(void* p) {
+    Shared* s = static_cast<Shared*>(p);
+    while (true) {
+        bool finished = s->done->load();
+        int* x = s->deque->steal();
+        if (x) {
+            (*s->taken)[*x]++;
+        } else if (finished && s->deque->empty()) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+// 完全二叉树, 第 i 个节点提交第 2i+1 和 2i+2 个节点
+// 只有根从外部提交, 其他线程只能靠窃取拿到任务
+struct Tree : Task {
+    ThreadPool* pool;
+    std::vector<Tree>* nodes;
+    size_t index;
+    std::atomic<long>* count;
+    void run() override {
+        for (size_t c = 2 * index + 1; c <= 2 * index + 2 && c < nodes->size(); c++) {
+            pool->addTask(&(*nodes)[c]);
+        }
+        (*count)++;
+    }
+};
+
+int main() {
+    // 单线程: 所有者后进先出, 窃取者先进先出, 超过初始容量时扩容
+    {
+        WorkStealingDeque<int> deque(4);
+        std::vector<int> v(100);
+        for (int i = 0; i < 100; i++) {
+            v[i] = i;
+            deque.push(&v[i]);
+        }
+        assert(deque.size() == 100);
+        assert(*deque.steal() == 0 && *deque.steal() == 1);
+        assert(*deque.pop() == 99 && *deque.pop() == 98);
+        for (int i = 2; i < 98; i++) assert(*deque.pop() == 97 - (i - 2));
+        assert(deque.empty() && deque.pop() == nullptr && deque.steal() == nullptr);
+    }
+
+    // 所有者一边 push / pop, 三个窃取者一边偷: 每个元素恰好被拿走一次
+    {
+        WorkStealingDeque<int> deque(8);
+        std::vector<int> v(items);
+        std::vector<std::atomic<int>> taken(items);
+        std::atomic<bool> done(false);
+        Shared shared = {&deque, &taken, &done};
+        pthread_t thieves[3];
+        for (auto& t : thieves) pthread_create(&t, nullptr, thief, &shared);
+
+        for (int i = 0; i < items; i++) {
+            v[i] = i;
+            deque.push(&v[i]);
+            if (i % 3 == 0) {
+                int* x = deque.pop();
+                if (x) taken[*x]++;
+            }
+        }
+        while (int* x = deque.pop()) taken[*x]++;
+        done = true;
+        for (auto& t : thieves) pthread_join(t, nullptr);
+        for (int i = 0; i < items; i++) assert(taken[i] == 1);
+    }
+
+    // 线程池中工作线程提交的任务进入自己的队列, 空闲线程窃取
+    {
+        ThreadPool pool(4);
+        std::atomic<long> count(0);
+        std::vector<Tree> nodes((1 << 17) - 1);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            nodes[i].pool = &pool;
+            nodes[i].nodes = &nodes;
+            nodes[i].index = i;
+            nodes[i].count = &count;
+        }
+        pool.addTask(&nodes[0]);
+        assert(pool.waitIdle() == 0 && count == long(nodes.size()));
+        PoolMetrics m = pool.getMetrics();
+        uint64_t steals = 0;
+        for (auto& w : m.workers) steals += w.steals;
+        printf("steals: %lu\n", (unsigned long)steals);
+        pool.shutdown();
+    }
+
+    printf("work_stealing_deque ok\n");
+    return 0;
+}
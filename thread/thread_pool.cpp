@@ -1,113 +1,966 @@
 #include "thread_pool.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "timer_wheel.h"
 
 // 静态成员初始化
-std::deque<Task*> ThreadPool::task_list;
-bool ThreadPool::exit = false;
-pthread_mutex_t ThreadPool::mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t ThreadPool::cond = PTHREAD_COND_INITIALIZER;
+thread_local ThreadPool::Worker* ThreadPool::current_worker = nullptr;
+thread_local const CancelToken* ThreadPool::current_token = nullptr;
+
+// 非工作线程帮忙执行任务时选择窃取目标用
+static thread_local unsigned int helper_seed = 1;
+
+// 自旋等待时降低功耗, 也让出流水线给同一物理核上的另一个超线程
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
 
 void Task::setData(void* data) { this->data = data; }
 
-ThreadPool::ThreadPool(int thread_num) {
-    this->thread_num = thread_num;
-    printf("create %d threads\n", thread_num);
-    create();
+bool CancelToken::isCancelled() const {
+    if (cancelled.load(std::memory_order_acquire)) {
+        return true;
+    }
+    uint64_t d = deadline.load(std::memory_order_relaxed);
+    return d != 0 && ThreadPool::nowNs() >= d;
 }
 
-void ThreadPool::create() {
+// 按 cpus 中的编号查找拓扑信息, 找不到的当作单独的核
+static std::vector<CpuInfo> placeOnCpus(const std::vector<int>& cpus, int n) {
+    std::vector<CpuInfo> topology = readCpuTopology();
+    std::vector<CpuInfo> placement;
+    for (int i = 0; i < n && !cpus.empty(); i++) {
+        CpuInfo info = {cpus[i % cpus.size()], cpus[i % cpus.size()], cpus[i % cpus.size()], 0};
+        for (size_t j = 0; j < topology.size(); j++) {
+            if (topology[j].cpu == info.cpu) {
+                info = topology[j];
+            }
+        }
+        placement.push_back(info);
+    }
+    return placement;
+}
+
+ThreadPool::ThreadPool(int thread_num, size_t queue_capacity, OverflowPolicy policy, Affinity affinity)
+    : ThreadPool(thread_num, thread_num, 0, queue_capacity, policy,
+                 placeWorkers(readCpuTopology(), thread_num, affinity)) {}
+
+ThreadPool::ThreadPool(int thread_num, const std::vector<int>& cpus, size_t queue_capacity, OverflowPolicy policy)
+    : ThreadPool(thread_num, thread_num, 0, queue_capacity, policy, placeOnCpus(cpus, thread_num)) {}
+
+ThreadPool::ThreadPool(int min_threads, int max_threads, int idle_timeout_ms, size_t queue_capacity,
+                       OverflowPolicy policy)
+    : ThreadPool(min_threads, max_threads, idle_timeout_ms, queue_capacity, policy, std::vector<CpuInfo>()) {}
+
+ThreadPool::ThreadPool(int min_threads, int max_threads, int idle_timeout_ms, size_t queue_capacity,
+                       OverflowPolicy policy, const std::vector<CpuInfo>& placement)
+    : task_list{MPMCQueue<Task>(queue_capacity), MPMCQueue<Task>(queue_capacity), MPMCQueue<Task>(queue_capacity)},
+      deadline_heap(nullptr),
+      deadline_num(0),
+      policy(policy),
+      exit(false),
+      draining(false),
+      idle_num(0),
+      spinning_num(0),
+      wake_seq(0),
+      blocked_num(0),
+      space_seq(0),
+      pending_num(0),
+      drain_waiters(0),
+      drain_seq(0) {
+    // 至少保留一个线程, 否则最后一个线程退出后没有人处理任务
+    this->min_num = min_threads < 1 ? 1 : min_threads;
+    this->thread_num = max_threads < min_num ? min_num : max_threads;
+    this->idle_timeout = uint64_t(idle_timeout_ms) * 1000000;
+    live_num = 0;
+    last_pop = nowNs();
+    // 最多一半的线程自旋, 并且至少留一个 CPU 给干活的线程, 单核机器上不自旋
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    this->max_spinning = std::min<long>((thread_num + 1) / 2, cpus - 1);
+    if (max_spinning < 0) {
+        max_spinning = 0;
+    }
+    // 每个线程池有自己的锁, 多个线程池之间互不影响
+    pthread_mutex_init(&mutex, nullptr);
+    tracer = nullptr;
+    tracing = nullptr;
+    metrics_on = false;
+    timers = nullptr;
+    pthread_mutex_init(&deadline_mutex, nullptr);
+    create(placement);
+}
+
+ThreadPool::~ThreadPool() {
+    // 没有调用过 stopAll 的话在这里停止所有线程
+    stopAll();
+    delete timers;
+    delete tracer;
+    pthread_mutex_destroy(&mutex);
+    pthread_mutex_destroy(&deadline_mutex);
+}
+
+void ThreadPool::create(const std::vector<CpuInfo>& placement) {
     pthread_id = new pthread_t[thread_num];
+    workers = new Worker[thread_num];
 
+    // 先把所有 Worker 初始化好再启动线程, 线程启动后马上就可能去偷别的 Worker 的任务
     for (int i = 0; i < thread_num; i++) {
-        // 不处理返回值
-        pthread_create(&pthread_id[i], nullptr, threadFunc, nullptr);
+        Worker& w = workers[i];
+        w.pool = this;
+        w.state = Worker::Empty;
+        w.index = i;
+        w.seed = i + 1;
+        w.ticks = 0;
+        w.cpu = placement.empty() ? -1 : placement[i].cpu;
+
+        // 其他线程按与自己的 CPU 距离分组, 先偷近的: 同一个物理核, 同一个 socket, 其他 socket
+        // 不绑定 CPU 时所有线程都在同一组
+        for (int d = 0; d <= 2; d++) {
+            for (int j = 0; j < thread_num; j++) {
+                int dist = placement.empty() ? 0 : cpuDistance(placement[i], placement[j]);
+                if (j != i && dist == d) {
+                    w.victims.push_back(j);
+                }
+            }
+            int last = w.victim_groups.empty() ? 0 : w.victim_groups.back();
+            if (int(w.victims.size()) > last) {
+                w.victim_groups.push_back(int(w.victims.size()));
+            }
+        }
+    }
+
+    // 先启动 min_num 个, 其余的位置在任务积压时再启动
+    for (int i = 0; i < min_num; i++) {
+        startWorker(i);
     }
 }
 
-void* ThreadPool::threadFunc(void* thread_data) {
+void ThreadPool::startWorker(int i) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (workers[i].cpu >= 0) {
+        // 线程创建时就绑定到指定的 CPU 上
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(workers[i].cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+    workers[i].state = Worker::Running;
+    workers[i].counters.start_time.store(nowNs(), std::memory_order_relaxed);
+    live_num++;
+    // 不处理返回值
+    pthread_create(&pthread_id[i], &attr, threadFunc, &workers[i]);
+    pthread_attr_destroy(&attr);
+}
+
+bool ThreadPool::backlogged() {
+    size_t depth = deadline_num.load(std::memory_order_relaxed);
+    for (int level = 0; level < priority_levels; level++) {
+        depth += task_list[level].size();
+    }
+    if (depth == 0) {
+        return false;
+    }
+    if (depth > size_t(live_num.load(std::memory_order_relaxed)) * grow_depth) {
+        return true;
+    }
+    // 所有线程都忙, 并且已经有一段时间没有线程来取任务了
+    return nowNs() - last_pop.load(std::memory_order_relaxed) > grow_wait;
+}
+
+void ThreadPool::grow() {
+    pthread_mutex_lock(&mutex);
+    if (!exit && live_num < thread_num) {
+        for (int i = 0; i < thread_num; i++) {
+            if (workers[i].state == Worker::Running) {
+                continue;
+            }
+            if (workers[i].state == Worker::Retired) {
+                // 退出的线程已经释放了 mutex, 不会再访问 Worker
+                pthread_join(pthread_id[i], nullptr);
+            }
+            startWorker(i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+Task* ThreadPool::spinForTask(Worker* self) {
+    // 自旋的线程太多会和干活的线程抢 CPU
+    if (spinning_num.load(std::memory_order_relaxed) >= max_spinning) {
+        return nullptr;
+    }
+    spinning_num.fetch_add(1);
+
+    Task* task = nullptr;
+    uint64_t start = nowNs();
+    for (int i = 1; !exit; i++) {
+        if (hasTask() && (task = getTask(self))) {
+            break;
+        }
+        cpuRelax();
+        if (i % 64 == 0 && nowNs() - start > spin_time) {
+            break;
+        }
+    }
+
+    // 先退出自旋状态再检查任务, 与 notify 中先放任务再检查 spinning_num 对应
+    spinning_num.fetch_sub(1);
+    if (task && hasTask()) {
+        // 自旋期间提交者没有唤醒睡眠的线程, 剩下的任务交给它们
+        notify();
+    }
+    return task;
+}
+
+bool ThreadPool::sleepIdle(Worker* self) {
+    // 先登记为睡眠状态再检查有没有任务
+    // 与 notify 中先放任务再检查 idle_num 对应, 两边至少有一边能看到对方, 不会丢失唤醒
+    idle_num.fetch_add(1);
+    bool keep = true;
     while (true) {
-        // 互斥锁 同一时刻只能有一个线程进入临界区
-        // 获取互斥锁 mutex, 进入临界区
+        // 检查任务之前读 wake_seq, 之后 notify 修改了它的话 futexWait 会立即返回
+        uint32_t seq = wake_seq.load();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (hasTask() || exit) {
+            break;
+        }
+
+        if (idle_timeout == 0 || live_num <= min_num) {
+            // 被唤醒后再检查一次是否有任务, 防止误唤醒
+            futexWait(&wake_seq, seq);
+            self->counters.wakeups.add(1);
+            continue;
+        }
+        if (futexWait(&wake_seq, seq, idle_timeout)) {
+            self->counters.wakeups.add(1);
+            continue;
+        }
+
+        // 空闲超时 退出本线程, 位置留给以后增加的线程
         pthread_mutex_lock(&mutex);
+        if (!hasTask() && !exit && live_num > min_num) {
+            self->state = Worker::Retired;
+            live_num--;
+            keep = false;
+            // 运行时间累计到这个位置上, 下一个在这里启动的线程接着算
+            uint64_t now = nowNs();
+            self->counters.idleEnd(now);
+            self->counters.retired_ns.add(now - self->counters.start_time.load(std::memory_order_relaxed));
+            self->counters.start_time.store(0, std::memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&mutex);
+        if (!keep) {
+            break;
+        }
+    }
+    idle_num.fetch_sub(1);
+    return keep;
+}
+
+void* ThreadPool::threadFunc(void* thread_data) {
+    Worker* self = static_cast<Worker*>(thread_data);
+    ThreadPool* pool = self->pool;
+    current_worker = self;
+
+    while (true) {
+        Task* task = pool->exit ? nullptr : pool->getTask(self);
+
+        if (task == nullptr) {
+            // 自旋和睡眠的时间都算作空闲
+            self->counters.idleBegin(nowNs());
+            if (!pool->exit) {
+                // 任务间隔很短时, 自旋等到下一个任务比睡眠后再被唤醒快得多
+                task = pool->spinForTask(self);
+            }
+            if (task == nullptr && !pool->sleepIdle(self)) {
+                // 空闲超时退出, 统计已经在 sleepIdle 中结算
+                return nullptr;
+            }
+            self->counters.idleEnd(nowNs());
 
-        // 等待新任务
-        while (task_list.size() == 0 && !exit) {
-            // 自动释放互斥锁，使调用线程进入阻塞状态，等待条件变量的通知，等待结束后自动加锁
-            pthread_cond_wait(&cond, &mutex);
-            // 这里加循环是唤醒后进行再一次判断是否有任务，防止误唤醒
+            if (task == nullptr) {
+                // 关闭线程
+                if (pool->exit) {
+                    // 线程主动结束 终止当前线程 线程资源会被自动回收
+                    pthread_exit(nullptr);
+                }
+                continue;
+            }
         }
 
-        // 关闭线程
-        if (exit) {
-            // 释放互斥锁 mutex, 退出临界区
-            pthread_mutex_unlock(&mutex);
-            printf("tid : %lu exit\n", pthread_self());
-            // 线程主动结束 终止当前线程 线程资源会被自动回收
-            pthread_exit(nullptr);
+        // 热路径上不输出日志, 需要观察调度时用 startTrace
+        pool->execute(self, task);
+    }
+
+    return nullptr;
+}
+
+Task* ThreadPool::getTask(Worker* self) {
+    Task* task;
+
+    // 每隔 starvation_interval 次先从低优先级往高优先级取一次
+    // 高优先级任务源源不断时, 低优先级的任务也能得到执行
+    if (self && ++self->ticks % starvation_interval == 0) {
+        for (int level = priority_levels - 1; level >= 0; level--) {
+            if ((task = popQueue(self, Priority(level)))) {
+                return task;
+            }
         }
+    }
 
-        printf("tid : %lu run: ", pthread_self());
+    // 截止时间队列和高优先级队列在自己的队列之前, 不用等手头的子任务做完
+    if ((task = popDeadline()) || (task = popQueue(self, Priority::High))) {
+        return task;
+    }
+
+    // 再取自己队列中最后放进去的任务
+    if (self && (task = self->deque.pop())) {
+        return task;
+    }
+
+    if ((task = popQueue(self, Priority::Normal)) || (task = popQueue(self, Priority::Low))) {
+        return task;
+    }
 
-        Task* task = nullptr;
-        // 取出一个任务 照理说到这里 task_list不会是空的
-        // while (task_list.size == 0 ...) 阻塞住了
-        if (!task_list.empty()) {
-            task = task_list.front();
-            task_list.pop_front();
+    // 最后去偷别人的
+    return stealTask(self);
+}
+
+Task* ThreadPool::popQueue(Worker* self, Priority priority) {
+    MPMCQueue<Task>& queue = task_list[int(priority)];
+
+    // 取注入队列中最早提交的任务
+    // 队列较长时一次取走一批, 平均分给每个线程, 多出来的放进自己的队列, 其他线程还可以来偷
+    // 高优先级的任务不成批取, 让空闲的线程都能马上拿到
+    size_t want = 1;
+    if (self && priority != Priority::High) {
+        want = queue.size() / size_t(live_num.load(std::memory_order_relaxed)) + 1;
+        if (want > max_batch) {
+            want = max_batch;
+        }
+    }
+    Task* batch[max_batch];
+    size_t n = queue.pop(batch, want);
+    if (n == 0) {
+        return nullptr;
+    }
+    for (size_t i = n - 1; i > 0; i--) {
+        self->deque.push(batch[i]);
+    }
+    if (live_num < thread_num) {
+        last_pop.store(nowNs(), std::memory_order_relaxed);
+        // 提交时可能有刚被唤醒还没开始干活的线程, 没有增加线程, 取任务时再检查一次
+        if (idle_num.load(std::memory_order_relaxed) == 0 && backlogged()) {
+            grow();
         }
+    }
+    notifySpace(int(n));
+    return batch[0];
+}
 
-        // 释放互斥锁 mutex, 退出临界区
-        pthread_mutex_unlock(&mutex);
+Task* ThreadPool::popDeadline() {
+    if (deadline_num.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+    Task* task = nullptr;
+    pthread_mutex_lock(&deadline_mutex);
+    if (deadline_heap) {
+        task = deadline_heap;
+        // 两趟合并: 先从左到右两两合并子树, 结果用 heap_sibling 倒序连起来, 再从右到左依次合并
+        Task* pairs = nullptr;
+        Task* node = task->heap_child;
+        while (node) {
+            Task* a = node;
+            Task* b = node->heap_sibling;
+            node = b ? b->heap_sibling : nullptr;
+            a->heap_sibling = nullptr;
+            if (b) {
+                b->heap_sibling = nullptr;
+            }
+            Task* m = meldDeadline(a, b);
+            m->heap_sibling = pairs;
+            pairs = m;
+        }
+        Task* root = nullptr;
+        while (pairs) {
+            Task* next = pairs->heap_sibling;
+            pairs->heap_sibling = nullptr;
+            root = meldDeadline(pairs, root);
+            pairs = next;
+        }
+        deadline_heap = root;
+        task->heap_child = nullptr;
+        deadline_num.store(deadline_num.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&deadline_mutex);
+    return task;
+}
 
-        task->run();
+Task* ThreadPool::meldDeadline(Task* a, Task* b) {
+    if (a == nullptr) {
+        return b;
+    }
+    if (b == nullptr) {
+        return a;
+    }
+    if (b->deadline < a->deadline) {
+        std::swap(a, b);
+    }
+    // 截止时间晚的成为另一个的第一个子节点
+    b->heap_sibling = a->heap_child;
+    a->heap_child = b;
+    return a;
+}
 
-        printf("tid : %lu idle\n", pthread_self());
+Task* ThreadPool::stealTask(Worker* self) {
+    if (thread_num == 0) {
+        return nullptr;
     }
 
+    if (self) {
+        // 由近到远一组一组地尝试, 组内从随机的一个开始, 避免所有空闲线程都去偷同一个
+        const std::vector<int>& victims = self->victims;
+        int begin = 0;
+        for (size_t g = 0; g < self->victim_groups.size(); g++) {
+            int end = self->victim_groups[g];
+            int start = rand_r(&self->seed) % (end - begin);
+            for (int i = 0; i < end - begin; i++) {
+                Task* task = workers[victims[begin + (start + i) % (end - begin)]].deque.steal();
+                if (task) {
+                    self->counters.steals.add(1);
+                    return task;
+                }
+            }
+            begin = end;
+        }
+        return nullptr;
+    }
+
+    // 非工作线程从随机的一个线程开始依次尝试
+    int start = rand_r(&helper_seed) % thread_num;
+    for (int i = 0; i < thread_num; i++) {
+        Task* task = workers[(start + i) % thread_num].deque.steal();
+        if (task) {
+            return task;
+        }
+    }
     return nullptr;
 }
 
-int ThreadPool::addTask(Task* task) {
-    // 获取互斥锁 mutex, 进入临界区
+bool ThreadPool::runPendingTask() {
+    // shutdownNow 之后工作线程的队列已经释放, 剩下的任务都已经交给它处理
+    // (停止过程中工作线程自己还要帮忙执行任务, 所以不能只看 exit)
+    if (workers == nullptr) {
+        return false;
+    }
+    Worker* self = current_worker;
+    if (self && self->pool != this) {
+        self = nullptr;
+    }
+
+    Task* task = getTask(self);
+    if (task == nullptr) {
+        return false;
+    }
+    execute(self, task);
+    return true;
+}
+
+void ThreadPool::submitted(Worker* self, Task* task) {
+    trace(self, TraceEvent::Enqueue, task);
+    if (metrics_on.load(std::memory_order_relaxed)) {
+        task->submit_time = nowNs();
+    }
+}
+
+void ThreadPool::execute(Worker* self, Task* task) {
+    const CancelToken* token = task->cancel_token;
+    if (token && token->isCancelled()) {
+        // 丢弃已经取消的任务, 不记录开始执行的事件和执行时间
+        task->submit_time = 0;
+        task->onCancel();
+        if (self) {
+            self->counters.cancelled.add(1);
+        }
+        finishTasks();
+        return;
+    }
+
+    // 帮忙执行任务时可能嵌套, 执行完恢复外层任务的 token
+    const CancelToken* outer = current_token;
+    current_token = token;
+    trace(self, TraceEvent::Start, task);
+    // 非工作线程帮忙执行的任务不计入统计
+    if (self && metrics_on.load(std::memory_order_relaxed)) {
+        // run 中任务可能释放自己, 之后不能再访问 task
+        uint64_t start = nowNs();
+        if (task->submit_time != 0 && start > task->submit_time) {
+            self->counters.queue_wait.record(start - task->submit_time);
+        }
+        task->submit_time = 0;
+        task->run();
+        self->counters.run_time.record(nowNs() - start);
+    } else {
+        task->run();
+    }
+    trace(self, TraceEvent::End, task);
+    current_token = outer;
+    if (self) {
+        self->counters.tasks.add(1);
+    }
+    finishTasks();
+}
+
+bool helpPendingTask() {
+    ThreadPool::Worker* self = ThreadPool::current_worker;
+    return self && self->pool->runPendingTask();
+}
+
+bool currentTaskCancelled() {
+    const CancelToken* token = ThreadPool::current_token;
+    return token && token->isCancelled();
+}
+
+bool ThreadPool::hasTask() {
+    if (deadline_num.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    for (int level = 0; level < priority_levels; level++) {
+        if (!task_list[level].empty()) {
+            return true;
+        }
+    }
+    for (int i = 0; i < thread_num; i++) {
+        if (!workers[i].deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::notify(int n) {
+    // 先放任务再检查 spinning_num 和 idle_num, 见 spinForTask 和 sleepIdle
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // 自旋的线程马上就会拿到任务, 不用为它们唤醒睡眠的线程
+    // 拿到任务的自旋线程发现还有剩余任务时会再唤醒下一个
+    n -= spinning_num.load(std::memory_order_relaxed);
+    if (n <= 0) {
+        return;
+    }
+    int idle = idle_num.load(std::memory_order_relaxed);
+    if (idle > 0) {
+        wake_seq.fetch_add(1);
+        futexWake(&wake_seq, n);
+    } else if (live_num < thread_num && backlogged()) {
+        // 没有空闲的线程, 任务又积压了
+        grow();
+    }
+}
+
+void ThreadPool::notifySpace(int n) {
+    if (policy != OverflowPolicy::Block) {
+        return;
+    }
+    // 先腾出空位再检查 blocked_num, 见 waitForSpace
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blocked_num.load(std::memory_order_relaxed) > 0) {
+        space_seq.fetch_add(1, std::memory_order_relaxed);
+        futexWake(&space_seq, n);
+    }
+}
+
+int ThreadPool::waitForSpace(Task* task, MPMCQueue<Task>& queue) {
+    while (true) {
+        // 先登记再重试, 与 notifySpace 中先腾出空位再检查 blocked_num 对应
+        blocked_num.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t seq = space_seq.load(std::memory_order_relaxed);
+
+        bool pushed = queue.push(task);
+        if (!pushed && !exit) {
+            futexWait(&space_seq, seq);
+        }
+        blocked_num.fetch_sub(1, std::memory_order_relaxed);
+
+        if (pushed) {
+            return 0;
+        }
+        if (exit) {
+            return -1;
+        }
+    }
+}
+
+int ThreadPool::addTask(Task* task, Priority priority) {
+    Worker* self = current_worker;
+    bool in_worker = self && self->pool == this;
+    MPMCQueue<Task>& queue = task_list[int(priority)];
+
+    // 入队前计数和记录, 任务入队后可能马上就被执行完并释放
+    pending_num.fetch_add(1, std::memory_order_relaxed);
+    submitted(in_worker ? self : nullptr, task);
+
+    if (in_worker && priority == Priority::Normal) {
+        // 工作线程提交的子任务放进自己的队列, 不需要加锁
+        self->deque.push(task);
+    } else if (exit || (draining && !in_worker)) {
+        finishTasks();
+        return -1;
+    } else if (queue.push(task)) {
+        // 已入队
+    } else if (in_worker) {
+        // 这里不限制容量, 否则工作线程可能阻塞在等待自己消费的队列上
+        self->deque.push(task);
+    } else {
+        switch (policy) {
+            case OverflowPolicy::Block:
+                if (waitForSpace(task, queue) != 0) {
+                    finishTasks();
+                    return -1;
+                }
+                break;
+            case OverflowPolicy::Fail:
+                finishTasks();
+                return -1;
+            case OverflowPolicy::CallerRuns:
+                // 由提交者自己执行, 提交速度自然降到处理速度 (已经取消的直接丢弃)
+                execute(nullptr, task);
+                return 0;
+        }
+    }
+
+    notify();
+
+    return 0;
+}
+
+int ThreadPool::addTasks(Task* const* first, Task* const* last, Priority priority) {
+    int n = int(last - first);
+    Worker* self = current_worker;
+    bool in_worker = self && self->pool == this;
+    MPMCQueue<Task>& queue = task_list[int(priority)];
+
+    pending_num.fetch_add(n, std::memory_order_relaxed);
+    if (tracing.load(std::memory_order_relaxed) || metrics_on.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < n; i++) submitted(in_worker ? self : nullptr, first[i]);
+    }
+
+    if (in_worker && priority == Priority::Normal) {
+        for (int i = 0; i < n; i++) self->deque.push(first[i]);
+        notify(n);
+        return n;
+    }
+
+    int done = 0;
+    while (done < n && !exit && !(draining && !in_worker)) {
+        int k = int(queue.push(first + done, size_t(n - done)));
+        if (k > 0) {
+            // 每入队一段就唤醒线程, Block 策略下要靠它们腾出空位
+            done += k;
+            notify(k);
+            continue;
+        }
+
+        // 队列满了
+        if (in_worker) {
+            for (; done < n; done++) self->deque.push(first[done]);
+            notify(n);
+            break;
+        }
+        if (policy == OverflowPolicy::Fail) {
+            break;
+        }
+        if (policy == OverflowPolicy::CallerRuns) {
+            execute(nullptr, first[done]);
+            done++;
+            continue;
+        }
+        if (waitForSpace(first[done], queue) != 0) {
+            break;
+        }
+        done++;
+        notify();
+    }
+
+    if (done < n) {
+        finishTasks(n - done);
+    }
+    return done;
+}
+
+int ThreadPool::addDeadlineTask(Task* task, uint64_t deadline) {
+    Worker* self = current_worker;
+    bool in_worker = self && self->pool == this;
+    pending_num.fetch_add(1, std::memory_order_relaxed);
+    submitted(in_worker ? self : nullptr, task);
+    if (exit || (draining && !in_worker)) {
+        finishTasks();
+        return -1;
+    }
+
+    pthread_mutex_lock(&deadline_mutex);
+    task->deadline = deadline;
+    deadline_heap = meldDeadline(deadline_heap, task);
+    deadline_num.store(deadline_num.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    pthread_mutex_unlock(&deadline_mutex);
+
+    notify();
+
+    return 0;
+}
+
+int ThreadPool::startTrace(const char* path, size_t capacity) {
+    pthread_mutex_lock(&mutex);
+    if (tracer == nullptr) {
+        tracer = new Tracer(thread_num, capacity);
+    }
+    int ret = -1;
+    if (tracing.load() == nullptr && tracer->open(path) == 0) {
+        tracing.store(tracer, std::memory_order_release);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+long ThreadPool::stopTrace() {
     pthread_mutex_lock(&mutex);
-    task_list.push_back(task);
-    // 释放互斥锁 mutex, 退出临界区
+    long dropped = -1;
+    if (tracing.load() != nullptr) {
+        // 之后才看到 tracing 为空的线程写进来的事件留在缓冲区中, 下次 startTrace 时丢掉
+        tracing.store(nullptr);
+        dropped = long(tracer->close());
+    }
     pthread_mutex_unlock(&mutex);
+    return dropped;
+}
+
+void ThreadPool::finishTasks(long n) {
+    // 与 waitIdle 中先登记再检查 pending_num 对应, 都是 seq_cst 操作, 两边至少有一边能看到对方
+    if (pending_num.fetch_sub(n) == n && drain_waiters.load() > 0) {
+        drain_seq.fetch_add(1);
+        futexWake(&drain_seq);
+    }
+}
+
+int ThreadPool::waitIdle() {
+    Worker* self = current_worker;
+    if (self && self->pool == this) {
+        return -1;
+    }
 
-    // 唤醒等待在指定条件变量cond上的一个线程, 使其从阻塞状态变为可运行状态
-    pthread_cond_signal(&cond);
+    drain_waiters.fetch_add(1);
+    while (true) {
+        // 检查之前读 drain_seq, 之后 finishTasks 修改了它的话 futexWait 会立即返回
+        uint32_t seq = drain_seq.load();
+        if (pending_num.load() == 0) {
+            break;
+        }
+        futexWait(&drain_seq, seq);
+    }
+    drain_waiters.fetch_sub(1);
+    return 0;
+}
 
+int ThreadPool::shutdown() {
+    Worker* self = current_worker;
+    if (exit || (self && self->pool == this)) {
+        return -1;
+    }
+
+    // 先拒绝新任务, 排队的任务 (以及它们提交的子任务) 执行完之后再停止
+    // 没有到期的定时任务不再等待, 和 stopAll 一样对它们调用 onCancel, 让提交者知道它们被丢弃
+    std::vector<Task*> timer_tasks;
+    pthread_mutex_lock(&mutex);
+    TimerWheel* wheel = timers;
+    pthread_mutex_unlock(&mutex);
+    if (wheel) {
+        wheel->stop(&timer_tasks);
+    }
+    draining = true;
+    waitIdle();
+    stopAll();
+    // 线程都已退出, 周期任务不会再有一次正在执行
+    for (size_t i = 0; i < timer_tasks.size(); i++) {
+        timer_tasks[i]->onCancel();
+    }
     return 0;
 }
 
-int ThreadPool::stopAll() {
+std::vector<Task*> ThreadPool::shutdownNow() {
+    std::vector<Task*> unrun;
     if (exit) {
-        return -1;
+        return unrun;
     }
 
-    printf("stop all threads\n");
+    // 先停止定时线程, 没有到期的定时任务也算没有执行
+    pthread_mutex_lock(&mutex);
+    TimerWheel* wheel = timers;
+    pthread_mutex_unlock(&mutex);
+    if (wheel) {
+        wheel->stop(&unrun);
+    }
+    size_t timer_num = unrun.size();
 
-    // 更新退出标记
+    // 更新退出标记 加锁保证之后不会再有新线程启动
+    pthread_mutex_lock(&mutex);
     exit = true;
-    // 唤醒所有等待在指定条件变量上的线程
-    pthread_cond_broadcast(&cond);
-    // 没有任务才会调用stopAll， 没有任务线程会进入阻塞状态
-    // threadFunc中会根据exit标志退出线程
+    pthread_mutex_unlock(&mutex);
+    // 唤醒所有睡眠的线程
+    wake_seq.fetch_add(1);
+    futexWake(&wake_seq);
+    // 唤醒等待空位的生产者, 它们看到 exit 后返回 -1
+    space_seq.fetch_add(1, std::memory_order_relaxed);
+    futexWake(&space_seq);
+    // 工作线程执行完手头的任务后, 根据 exit 标志退出, 不再取新任务
 
     for (int i = 0; i < thread_num; i++) {
         // pthread_join 阻塞当前线程, 等待指定的线程运行结束后再继续执行
         // 让指定线程所占的资源得到释放
-        pthread_join(pthread_id[i], nullptr);
+        if (workers[i].state != Worker::Empty) {
+            pthread_join(pthread_id[i], nullptr);
+        }
+    }
+
+    // 线程都已退出, 剩下的任务按定时任务, 截止时间队列, 各优先级队列, 各线程队列的顺序交给调用者
+    Task* task;
+    while ((task = popDeadline())) unrun.push_back(task);
+    for (int level = 0; level < priority_levels; level++) {
+        while ((task = task_list[level].pop())) unrun.push_back(task);
+    }
+    for (int i = 0; i < thread_num; i++) {
+        while ((task = workers[i].deque.steal())) unrun.push_back(task);
     }
 
     delete[] pthread_id;
     pthread_id = nullptr;
 
-    pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&cond);
+    delete[] workers;
+    workers = nullptr;
+
+    // 没有执行的任务不再计入, 唤醒 waitIdle (定时任务还没有提交, 不在计数中)
+    finishTasks(long(unrun.size() - timer_num));
+
+    // 内部创建的任务调用者既不能释放, 也不知道它们的存在, 在这里释放并通知等待者
+    // (Future 得到 TaskCancelled, TaskGroup 和 TaskGraph 的等待返回, 协程从 co_await schedule 抛出异常)
+    size_t kept = 0;
+    for (size_t i = 0; i < unrun.size(); i++) {
+        if (unrun[i]->ownedByPool()) {
+            unrun[i]->onCancel();
+        } else {
+            unrun[kept++] = unrun[i];
+        }
+    }
+    unrun.resize(kept);
+    return unrun;
+}
+
+uint64_t ThreadPool::scheduleAfter(uint64_t delay, Task* task, Priority priority) {
+    pthread_mutex_lock(&mutex);
+    if (exit || draining) {
+        pthread_mutex_unlock(&mutex);
+        return 0;
+    }
+    if (timers == nullptr) {
+        timers = new TimerWheel(this);
+    }
+    TimerWheel* wheel = timers;
+    pthread_mutex_unlock(&mutex);
+    return wheel->add(delay, 0, task, priority);
+}
 
+uint64_t ThreadPool::scheduleEvery(uint64_t period, Task* task, Priority priority) {
+    pthread_mutex_lock(&mutex);
+    if (exit || draining) {
+        pthread_mutex_unlock(&mutex);
+        return 0;
+    }
+    if (timers == nullptr) {
+        timers = new TimerWheel(this);
+    }
+    TimerWheel* wheel = timers;
+    pthread_mutex_unlock(&mutex);
+    return wheel->add(period, period, task, priority);
+}
+
+int ThreadPool::cancelTimer(uint64_t id) {
+    pthread_mutex_lock(&mutex);
+    TimerWheel* wheel = timers;
+    pthread_mutex_unlock(&mutex);
+    return wheel ? wheel->cancel(id) : -1;
+}
+
+int ThreadPool::stopAll() {
+    if (exit) {
+        return -1;
+    }
+    // 没有人接收剩下的任务, 同样通过 onCancel 通知它们被丢弃
+    std::vector<Task*> unrun = shutdownNow();
+    for (size_t i = 0; i < unrun.size(); i++) {
+        unrun[i]->onCancel();
+    }
     return 0;
 }
 
-size_t ThreadPool::getTaskSize() { return task_list.size(); }
\ No newline at end of file
+PoolMetrics ThreadPool::getMetrics() {
+    PoolMetrics metrics;
+    metrics.queued = getTaskSize();
+    metrics.live_threads = getThreadNum();
+
+    // 线程的启动和退出都持有 mutex, 运行时间和退出时的结算是一致的
+    pthread_mutex_lock(&mutex);
+    uint64_t now = nowNs();
+    for (int i = 0; workers && i < thread_num; i++) {
+        const WorkerCounters& c = workers[i].counters;
+        uint64_t start = c.start_time.load(std::memory_order_relaxed);
+        uint64_t uptime = c.retired_ns.get() + (start ? now - start : 0);
+        if (uptime == 0) {
+            // 这个位置上还没有启动过线程
+            continue;
+        }
+        uint64_t idle_since = c.idle_since.load(std::memory_order_relaxed);
+        uint64_t idle = c.idle_ns.get() + (idle_since && now > idle_since ? now - idle_since : 0);
+
+        WorkerMetrics w;
+        w.index = i;
+        w.running = start != 0;
+        w.tasks = c.tasks.get();
+        w.steals = c.steals.get();
+        w.wakeups = c.wakeups.get();
+        w.cancelled = c.cancelled.get();
+        w.idle_ns = idle;
+        w.busy_ns = uptime > idle ? uptime - idle : 0;
+        metrics.workers.push_back(w);
+
+        c.queue_wait.collect(metrics.queue_wait);
+        c.run_time.collect(metrics.run_time);
+    }
+    pthread_mutex_unlock(&mutex);
+    return metrics;
+}
+
+size_t ThreadPool::getTaskSize() {
+    size_t size = deadline_num.load(std::memory_order_relaxed);
+    for (int level = 0; level < priority_levels; level++) {
+        size += task_list[level].size();
+    }
+
+    // stopAll 之后 workers 已经释放
+    for (int i = 0; workers && i < thread_num; i++) {
+        size += workers[i].deque.size();
+    }
+    return size;
+}
@@ -1,43 +1,512 @@
 #pragma once
 
 #include <pthread.h>
+#include <time.h>
 
+#include <atomic>
 #include <cstddef>
-#include <deque>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <new>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "block_pool.h"
+#include "cpu_topology.h"
+#include "futex.h"
+#include "metrics.h"
+#include "mpmc_queue.h"
+#include "trace.h"
+#include "work_stealing_deque.h"
+
+// 协作式取消
+// 设置了 token 的任务从队列中取出时先检查 token, 已经取消的不执行 run, 改为调用 onCancel 后丢弃
+// 正在执行的任务不会被打断, 长时间运行的任务自己定期检查 (isCancelled 或 currentTaskCancelled), 提前返回
+// 一个 token 可以给任意多个任务用, 这些任务执行完或被丢弃之前不能销毁
+class CancelToken {
+public:
+    CancelToken() : cancelled(false), deadline(0) {}
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    void cancel() { cancelled.store(true, std::memory_order_release); }
+    // 到 deadline (ThreadPool::nowNs() 的时间) 时自动取消, 0 表示不限时
+    void setDeadline(uint64_t deadline) { this->deadline.store(deadline, std::memory_order_relaxed); }
+    // 设置了截止时间时要读一次时钟
+    bool isCancelled() const;
+
+private:
+    std::atomic<bool> cancelled;
+    std::atomic<uint64_t> deadline;
+};
+
+// 任务被取消 (或线程池停止时被丢弃) 没有执行, 等待它结果的 Future::get 抛出这个异常
+class TaskCancelled : public std::exception {
+public:
+    const char* what() const noexcept override { return "task cancelled"; }
+};
 
 class Task {
 public:
     Task() = default;
     Task(std::string& task_name) : task_name(task_name), data(nullptr) {}
     void setData(void* data);
+    const std::string& getName() const { return task_name; }
+    // 开始执行前检查 token, nullptr 表示不能取消
+    void setCancelToken(const CancelToken* token) { cancel_token = token; }
+    const CancelToken* getCancelToken() const { return cancel_token; }
     // 包含纯虚函数的类(也就是抽象类）不能直接实例化
     // 子类继承抽象类后，必须实现抽象类中的所有纯虚函数，否则子类也属于抽象类
     virtual void run() = 0;
     ~Task() = default;
 
 protected:
+    // 任务因为取消没有执行时代替 run 调用, 在 run 中释放自己的任务要在这里释放
+    // 线程池停止时丢弃的任务也会调用 (见 ThreadPool::shutdownNow)
+    virtual void onCancel() {}
+    // 任务由本库的组件创建和释放 (submit, TaskGroup, 并行算法, TaskGraph, 协程, AsyncIO 的回调),
+    // 提交者拿不到它的指针, shutdownNow 不把它返回给调用者, 而是调用 onCancel 释放
+    virtual bool ownedByPool() const { return false; }
+
     std::string task_name;  // 任务的名称
     void* data;             // 执行任务的具体数据
+
+private:
+    friend class ThreadPool;
+    const CancelToken* cancel_token = nullptr;
+    uint64_t submit_time = 0;  // 提交的时间, 只在线程池打开统计时记录
+    // 截止时间队列是以任务本身为节点的配对堆, 入队不分配内存, 由 deadline_mutex 保护
+    uint64_t deadline = 0;
+    Task* heap_child = nullptr;    // 第一个子节点
+    Task* heap_sibling = nullptr;  // 下一个兄弟节点
+};
+
+// 当前线程是某个线程池的工作线程时, 执行一个该线程池中排队的任务
+// 不是工作线程或者没有任务返回 false
+// 工作线程等待其他任务时用它帮忙干活, 不占着线程空等, 嵌套的 fork-join 不会因为所有线程都在等待而死锁
+bool helpPendingTask();
+
+// 当前线程正在执行的任务设置了 token 并且已经取消
+// 长时间运行的任务可以用它检查, 不需要自己保存 token; 不在任务中返回 false
+bool currentTaskCancelled();
+
+// 任务的返回值 任务完成前未构造
+template <typename R>
+class FutureValue {
+public:
+    FutureValue() : has_value(false) {}
+    ~FutureValue() {
+        if (has_value) reinterpret_cast<R*>(buf)->~R();
+    }
+
+    template <typename F>
+    void setFrom(F& f) {
+        new (buf) R(f());
+        has_value = true;
+    }
+
+    R take() { return std::move(*reinterpret_cast<R*>(buf)); }
+
+private:
+    alignas(R) unsigned char buf[sizeof(R)];
+    bool has_value;
+};
+
+template <>
+class FutureValue<void> {
+public:
+    template <typename F>
+    void setFrom(F& f) {
+        f();
+    }
+
+    void take() {}
+};
+
+// submit 提交的任务和它的结果放在同一个节点里
+// 节点由线程池和 Future 共同持有, 引用计数归零时释放
+template <typename R>
+class FutureState : public Task {
+public:
+    FutureState() : refs(2), done(0), waiters(0) {}
+
+    bool isReady() const { return done.load(std::memory_order_acquire) != 0; }
+
+    void wait() {
+        int idle_rounds = 0;
+        while (!isReady() && idle_rounds < 64) {
+            idle_rounds = helpPendingTask() ? 0 : idle_rounds + 1;
+        }
+        if (isReady()) {
+            return;
+        }
+        // 先登记再检查, 与 complete 中先置位再检查 waiters 对应
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        while (done.load(std::memory_order_seq_cst) == 0) {
+            futexWait(&done, 0);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    R get() {
+        wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return value.take();
+    }
+
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            destroy();
+        }
+    }
+
+protected:
+    // 由知道节点实际类型和大小的子类释放节点
+    // 用虚函数而不是保存函数指针, 节点小 8 个字节, 小任务的节点能放进 128 字节的块
+    virtual void destroy() = 0;
+
+    template <typename F>
+    void complete(F& f) {
+        try {
+            value.setFrom(f);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        publish();
+    }
+
+    // 任务没有执行, get 抛出 TaskCancelled
+    void cancelled() {
+        error = std::make_exception_ptr(TaskCancelled());
+        publish();
+    }
+
+private:
+    void publish() {
+        done.store(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) > 0) {
+            futexWake(&done);
+        }
+    }
+
+    std::atomic<int> refs;
+    std::atomic<uint32_t> done;
+    std::atomic<uint32_t> waiters;  // 睡眠等待结果的线程数
+    FutureValue<R> value;           // 小的返回值放在上面三个计数后的空隙里
+    std::exception_ptr error;
 };
 
+// 可调用对象和参数直接放在节点里, 节点从 BlockPool 分配
+template <typename R, typename F, typename Args>
+class FunctionTask : public FutureState<R> {
+public:
+    template <typename G, typename... A>
+    static FunctionTask* create(G&& g, A&&... a) {
+        void* p = blockAllocate(sizeof(FunctionTask), alignof(FunctionTask));
+        return new (p) FunctionTask(std::forward<G>(g), std::forward<A>(a)...);
+    }
+
+    void run() override {
+        auto call = [this]() -> R { return std::apply(func, std::move(args)); };
+        this->complete(call);
+        this->release();
+    }
+
+protected:
+    // 没有执行就被丢弃: 让 Future 得到 TaskCancelled, 再释放线程池持有的引用
+    void onCancel() override {
+        this->cancelled();
+        this->release();
+    }
+
+    bool ownedByPool() const override { return true; }
+
+private:
+    template <typename G, typename... A>
+    FunctionTask(G&& g, A&&... a)
+        : func(std::forward<G>(g)), args(std::forward<A>(a)...) {}
+
+    void destroy() override {
+        this->~FunctionTask();
+        blockDeallocate(this, sizeof(FunctionTask), alignof(FunctionTask));
+    }
+
+    F func;
+    Args args;
+};
+
+// submit 的返回值 只能移动, get 只能调用一次
+template <typename R>
+class Future {
+public:
+    Future() : state(nullptr) {}
+    explicit Future(FutureState<R>* state) : state(state) {}
+    Future(Future&& other) : state(other.state) { other.state = nullptr; }
+    Future& operator=(Future&& other) {
+        if (this != &other) {
+            reset();
+            state = other.state;
+            other.state = nullptr;
+        }
+        return *this;
+    }
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+    ~Future() { reset(); }
+
+    bool valid() const { return state != nullptr; }
+    bool isReady() const { return state->isReady(); }
+    void wait() const { state->wait(); }
+
+    // 等待任务完成并取出结果, 任务抛出的异常在这里重新抛出
+    R get() {
+        FutureState<R>* s = state;
+        state = nullptr;
+        struct Guard {
+            FutureState<R>* s;
+            ~Guard() { s->release(); }
+        } guard{s};
+        return s->get();
+    }
+
+private:
+    void reset() {
+        if (state) {
+            state->release();
+            state = nullptr;
+        }
+    }
+
+    FutureState<R>* state;
+};
+
+// 注入队列满时 addTask 的处理方式
+enum class OverflowPolicy {
+    Block,       // 阻塞等待队列有空位
+    Fail,        // 立即返回 -1
+    CallerRuns,  // 在调用线程中直接执行任务
+};
+
+// 任务优先级
+// 工作线程总是先取高优先级的任务, 但每隔一段时间会先看一次低优先级, 低优先级不会被饿死
+enum class Priority {
+    High = 0,    // 延迟敏感的任务
+    Normal = 1,
+    Low = 2,     // 后台批处理任务
+};
+
+class TimerWheel;
+
 class ThreadPool {
 public:
-    ThreadPool(int thread_num);  // 设置线程池大小
-    int addTask(Task* task);
+    // 设置线程池大小, 注入队列容量, 队列满时的处理方式和工作线程的放置方式
+    ThreadPool(int thread_num, size_t queue_capacity = 4096, OverflowPolicy policy = OverflowPolicy::Block,
+               Affinity affinity = Affinity::None);
+    // 第 i 个工作线程绑定到 cpus[i % cpus.size()]
+    ThreadPool(int thread_num, const std::vector<int>& cpus, size_t queue_capacity = 4096,
+               OverflowPolicy policy = OverflowPolicy::Block);
+    // 线程数在 [min_threads, max_threads] 之间自动调整
+    // 没有空闲线程且任务积压 (排队任务数超过线程数的 grow_depth 倍, 或者超过 grow_wait_ms 没有线程来取任务) 时增加线程
+    // 多于 min_threads 时, 空闲超过 idle_timeout_ms 的线程退出
+    ThreadPool(int min_threads, int max_threads, int idle_timeout_ms, size_t queue_capacity = 4096,
+               OverflowPolicy policy = OverflowPolicy::Block);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // 其他线程调用时, 任务放进对应优先级的注入队列 task_list[priority], 队列满时按 policy 处理
+    // 在本线程池的工作线程中提交的 Normal 任务放进该线程自己的队列 (不受容量限制)
+    // 工作线程提交时注入队列满了也放进自己的队列, 不会阻塞或被拒绝
+    // 成功返回 0, 被拒绝 (Fail 策略或线程池已停止) 返回 -1
+    int addTask(Task* task, Priority priority = Priority::Normal);
+    // 批量提交 [first, last), 一次占住注入队列中的多个位置, 最后按任务数唤醒线程
+    // 返回被接受 (入队或由调用线程执行) 的任务数, [first + 返回值, last) 被拒绝
+    int addTasks(Task* const* first, Task* const* last, Priority priority = Priority::Normal);
+    // 提交截止时间为 deadline (nowNs() 的时间) 的任务, 比所有优先级队列都先取, 截止时间早的先执行
+    // 截止时间队列不限容量, 任务自身就是堆的节点, 入队不分配内存
+    int addDeadlineTask(Task* task, uint64_t deadline);
+
+    // 单调时钟 纳秒
+    static uint64_t nowNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+    }
+
+    // 提交 f(args...), 返回可以取结果的 Future
+    // f 和 args 按值保存在任务节点中, 不需要继承 Task
+    // 任务被拒绝时返回的 Future valid() 为 false
+    template <typename F, typename... Args>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(F&& f, Args&&... args) {
+        return submit(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(Priority priority, F&& f,
+                                                                                 Args&&... args) {
+        return submit(priority, nullptr, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // token 取消时还没开始的任务被丢弃, Future::get 抛出 TaskCancelled
+    template <typename F, typename... Args>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(const CancelToken* token, F&& f,
+                                                                                 Args&&... args) {
+        return submit(Priority::Normal, token, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> submit(Priority priority,
+                                                                                 const CancelToken* token, F&& f,
+                                                                                 Args&&... args) {
+        using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        using Node = FunctionTask<R, std::decay_t<F>, std::tuple<std::decay_t<Args>...>>;
+        Node* node = Node::create(std::forward<F>(f), std::forward<Args>(args)...);
+        node->setCancelToken(token);
+        if (addTask(node, priority) != 0) {
+            // 线程池和 Future 各持有一个引用
+            node->release();
+            node->release();
+            return Future<R>();
+        }
+        return Future<R>(node);
+    }
+    // 阻塞到已提交的任务 (排队的, 正在执行的, 以及执行中提交的子任务) 全部执行完
+    // 在本线程池的工作线程中调用会永远等不到自己的任务结束, 直接返回 -1
+    int waitIdle();
+    // 不再接受其他线程提交的任务, 排队的任务全部执行完后停止所有线程; 没有到期的定时任务调用 onCancel 后丢弃
+    // 正在执行的任务仍然可以提交子任务
+    int shutdown();
+    // 立即停止: 正在执行的任务结束后线程退出, 返回还没有执行的任务, 由调用者释放或转交
+    // 只返回调用者通过 addTask 等接口提交的任务; 本库内部创建的任务 (submit 的 Future, TaskGroup,
+    // 并行算法, TaskGraph, 协程, AsyncIO 的回调) 在这里调用 onCancel 释放, 等待它们的一方得到取消的结果
+    // 调用期间不能再有其他线程提交任务
+    std::vector<Task*> shutdownNow();
+    // 立即停止, 还没有执行的任务全部调用 onCancel 后丢弃 (调用者提交的任务不释放), 析构函数也是这样
     int stopAll();
+
+    // 定时任务 时间单位纳秒, 精度为 1 毫秒
+    // 到期时任务按 priority 放进注入队列, 等待期间不占用任何工作线程
+    // 返回定时器编号, 线程池已停止返回 0
+    // shutdown 和 shutdownNow 会取消没有到期的定时器: shutdown 对它们的任务调用 onCancel, shutdownNow 把任务返回给调用者
+    uint64_t scheduleAfter(uint64_t delay, Task* task, Priority priority = Priority::Normal);
+    // 每隔 period 提交一次 task, 第一次在 period 之后; 上一次还没执行完时下一次照样提交
+    uint64_t scheduleEvery(uint64_t period, Task* task, Priority priority = Priority::Normal);
+    // 取消没有到期的定时器, 成功返回 0, 已经到期 (一次性的) 或者已经取消返回 -1
+    int cancelTimer(uint64_t id);
     size_t getTaskSize();
+    // 开始把任务的提交, 开始和结束记录到 path (Chrome trace JSON), 每个线程最多缓冲 capacity 个还没写出的事件
+    // 成功返回 0, 已经在记录或者打不开文件返回 -1
+    int startTrace(const char* path, size_t capacity = 65536);
+    // 停止记录并写完文件, 返回因缓冲区满丢弃的事件数, 没有在记录返回 -1
+    long stopTrace();
+    // 打开后记录每个任务的排队时间和执行时间 (每个任务多读两次时钟)
+    // 任务数, 窃取数, 唤醒次数和忙闲时间一直记录
+    void enableMetrics(bool on) { metrics_on.store(on, std::memory_order_relaxed); }
+    // 各工作线程统计的快照, toText() 输出 Prometheus 文本格式
+    PoolMetrics getMetrics();
+    int getThreadNum() const { return live_num.load(std::memory_order_relaxed); }  // 当前的线程数
+
+    // 在调用线程中执行一个排队的任务, 没有任务返回 false
+    // 等待其他任务完成的线程可以用它帮忙干活, 而不是空等
+    bool runPendingTask();
+
+    friend bool helpPendingTask();
+    friend bool currentTaskCancelled();
 
 protected:
+    // 每个工作线程一个
+    struct Worker {
+        enum State { Empty, Running, Retired };  // 没有启动过, 正在运行, 空闲超时已退出 (还没有 join)
+
+        ThreadPool* pool;
+        State state;                      // 由 mutex 保护
+        int index;                        // 在 workers 数组中的下标
+        unsigned int seed;                // 随机选择窃取目标用
+        unsigned int ticks;               // 取任务的次数, 防止低优先级饿死
+        int cpu;                          // 绑定的 CPU, -1 表示不绑定
+        std::vector<int> victims;         // 窃取目标, 按 CPU 距离从近到远排列
+        std::vector<int> victim_groups;   // 每组距离相同的目标在 victims 中的结束位置
+        WorkStealingDeque<Task> deque;    // 本线程的任务队列
+        WorkerCounters counters;          // 本线程的统计
+    };
+
+    ThreadPool(int min_threads, int max_threads, int idle_timeout_ms, size_t queue_capacity, OverflowPolicy policy,
+               const std::vector<CpuInfo>& placement);
+
     static void* threadFunc(void* thread_data); // 在新线程中执行的函数
-    void create();  // 创建线程
+    void create(const std::vector<CpuInfo>& placement);  // 创建线程, placement 为空表示不绑定 CPU
+    void startWorker(int i);        // 在第 i 个位置启动一个工作线程
+    bool backlogged();              // 任务是否积压到需要增加线程
+    void grow();                    // 增加一个工作线程
+    Task* spinForTask(Worker* self);  // 睡眠前先自旋等待一会儿任务, 没等到返回 nullptr
+    bool sleepIdle(Worker* self);   // 在 wake_seq 上睡眠等待任务, 空闲超时需要退出时返回 false
+    Task* getTask(Worker* self);    // 按优先级从各个队列取任务, self 为 nullptr 表示非工作线程
+    Task* popQueue(Worker* self, Priority priority);  // 从注入队列取任务
+    Task* popDeadline();            // 取截止时间最早的任务
+    static Task* meldDeadline(Task* a, Task* b);  // 合并两个配对堆, 返回新的根
+    Task* stealTask(Worker* self);  // 从其他线程的队列偷一个任务, self 为 nullptr 表示非工作线程
+    bool hasTask();                 // 是否还有排队的任务
+    void notify(int n = 1);         // 有 n 个新任务时唤醒最多 n 个睡眠的线程, 有线程在自旋时少唤醒相应个数
+    int waitForSpace(Task* task, MPMCQueue<Task>& queue);  // Block 策略下等待注入队列有空位
+    void notifySpace(int n = 1);    // 从注入队列取走 n 个任务后唤醒等待空位的生产者
+    void submitted(Worker* self, Task* task);      // 任务被提交, 入队之前调用
+    void execute(Worker* self, Task* task);        // 执行一个取出的任务, 记录跟踪和统计
+    // 跟踪打开时记录一个事件, 关闭时只多一次原子读
+    void trace(Worker* self, TraceEvent::Type type, Task* task) {
+        Tracer* t = tracing.load(std::memory_order_acquire);
+        if (t) {
+            t->record(self ? self->index : -1, type, task, type == TraceEvent::End ? nullptr : &task->getName());
+        }
+    }
+    void finishTasks(long n = 1);   // n 个已提交的任务执行完 (或被拒绝), 全部完成时唤醒 waitIdle
 private:
-    static std::deque<Task*> task_list;  // 任务列表
-    static bool exit;                    // 线程退出的标志
-    int thread_num;                      // 线程池中启动的线程数
+    enum {
+        priority_levels = 3,
+        starvation_interval = 16,  // 每取这么多次任务, 先从低优先级取一次
+    };
+
+    MPMCQueue<Task> task_list[priority_levels];  // 任务列表 (注入队列, 外部线程提交的任务), 每个优先级一个
+    Task* deadline_heap;          // 按截止时间排列的配对堆的根, 截止时间最早
+    std::atomic<size_t> deadline_num;             // 堆中任务数, 不加锁判断是否为空
+    pthread_mutex_t deadline_mutex;
+    OverflowPolicy policy;        // 注入队列满时的处理方式
+    std::atomic<bool> exit;       // 线程退出的标志
+    std::atomic<bool> draining;   // shutdown 中, 不再接受其他线程提交的任务
+    int thread_num;               // 工作线程的最大个数 (workers 数组的大小)
+    int min_num;                  // 工作线程的最小个数
+    std::atomic<int> live_num;    // 正在运行的工作线程数, 由 mutex 保护修改
+    uint64_t idle_timeout;        // 空闲多久退出 (纳秒), 0 表示不退出
+    std::atomic<uint64_t> last_pop;  // 最后一次从注入队列取到任务的时间
     pthread_t* pthread_id;
+    Worker* workers;
+    std::atomic<int> idle_num;    // 正在睡眠等待任务的线程数
+    std::atomic<int> spinning_num;  // 正在自旋等待任务的线程数
+    int max_spinning;             // 同时自旋的线程数上限, 单核机器上为 0
+    std::atomic<uint32_t> wake_seq;   // 空闲线程在上面睡眠, 唤醒前加一
+    std::atomic<int> blocked_num; // 正在等待注入队列空位的生产者数
+    std::atomic<uint32_t> space_seq;  // 生产者在上面睡眠, 有空位时加一
+    std::atomic<long> pending_num;    // 已提交还没有执行完的任务数, 入队前加一, 执行完减一
+    std::atomic<int> drain_waiters;   // 正在 waitIdle 的线程数
+    std::atomic<uint32_t> drain_seq;  // waitIdle 在上面睡眠, pending_num 变为 0 时加一
+
+    pthread_mutex_t mutex;        // 保护线程的启动和退出, 以及跟踪的开始和停止
+    Tracer* tracer;               // 第一次 startTrace 时创建, 线程池析构时释放
+    std::atomic<Tracer*> tracing; // 正在记录时等于 tracer, 否则为 nullptr
+    std::atomic<bool> metrics_on; // 是否记录排队时间和执行时间
+    TimerWheel* timers;           // 第一次添加定时任务时创建, 由 mutex 保护创建
+
+    enum { max_batch = 32 };  // 工作线程一次从注入队列最多取走的任务数
+
+    static const int grow_depth = 2;                // 平均每个线程排队的任务数超过它时增加线程
+    static const uint64_t grow_wait = 1000000;      // 超过这么久 (纳秒) 没有线程来取任务时增加线程
+    static const uint64_t spin_time = 20000;        // 睡眠前自旋等待任务的时间 (纳秒)
 
-    static pthread_mutex_t mutex;
-    static pthread_cond_t cond;
+    static thread_local Worker* current_worker;  // 当前线程对应的 Worker, 非工作线程为 nullptr
+    static thread_local const CancelToken* current_token;  // 当前线程正在执行的任务的 token
 };
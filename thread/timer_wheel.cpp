@@ -0,0 +1,270 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+#include "futex.h"
+
+TimerWheel::TimerWheel(ThreadPool* pool)
+    : pool(pool), free_nodes(nullptr), count(0), now_tick(0), sleep_until(0), stopping(false), wake_seq(0) {
+    for (int level = 0; level < level_num; level++) {
+        for (int slot = 0; slot < slot_num; slot++) {
+            slots[level][slot].prev = slots[level][slot].next = &slots[level][slot];
+        }
+    }
+    start_time = ThreadPool::nowNs();
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_create(&thread, nullptr, threadFunc, this);
+}
+
+TimerWheel::~TimerWheel() {
+    stop(nullptr);
+    pthread_mutex_destroy(&mutex);
+}
+
+uint64_t TimerWheel::currentTick() { return (ThreadPool::nowNs() - start_time) / tick_ns; }
+
+uint64_t TimerWheel::nextTick() {
+    // 第 0 层转完一圈 (格子编号是 slot_num 的倍数) 时要从上层重新分配, 在此之前只看第 0 层
+    uint64_t cascade_tick = (now_tick + slot_num - 1) & ~uint64_t(slot_num - 1);
+    for (uint64_t t = now_tick; t < cascade_tick; t++) {
+        const Node* head = &slots[0][t & (slot_num - 1)];
+        if (head->next != head) {
+            return t;
+        }
+    }
+    return cascade_tick;
+}
+
+TimerWheel::Node* TimerWheel::allocNode() {
+    Node* node = free_nodes;
+    if (node) {
+        free_nodes = node->next;
+    } else {
+        nodes.emplace_back();
+        node = &nodes.back();
+        node->index = uint32_t(nodes.size() - 1);
+        node->generation = 0;
+    }
+    node->generation++;
+    node->active = true;
+    return node;
+}
+
+void TimerWheel::freeNode(Node* node) {
+    node->active = false;
+    node->task = nullptr;
+    node->next = free_nodes;
+    free_nodes = node;
+}
+
+void TimerWheel::link(Node* node) {
+    uint64_t expire = node->expire;
+    uint64_t idx = expire - now_tick;
+    Node* head;
+    if (expire < now_tick) {
+        // 已经过期, 放进下一个要处理的格子
+        head = &slots[0][now_tick & (slot_num - 1)];
+    } else if (idx < (uint64_t(1) << level_bits)) {
+        head = &slots[0][expire & (slot_num - 1)];
+    } else if (idx < (uint64_t(1) << (2 * level_bits))) {
+        head = &slots[1][(expire >> level_bits) & (slot_num - 1)];
+    } else if (idx < (uint64_t(1) << (3 * level_bits))) {
+        head = &slots[2][(expire >> (2 * level_bits)) & (slot_num - 1)];
+    } else {
+        // 超出时间轮范围的先放在最远的位置, 转到时再按真正的到期时间重新分配
+        if (idx >= (uint64_t(1) << (4 * level_bits))) {
+            expire = now_tick + (uint64_t(1) << (4 * level_bits)) - 1;
+        }
+        head = &slots[3][(expire >> (3 * level_bits)) & (slot_num - 1)];
+    }
+
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimerWheel::unlink(Node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+TimerWheel::Node* TimerWheel::detach(Node* head) {
+    if (head->next == head) {
+        return nullptr;
+    }
+    Node* first = head->next;
+    head->prev->next = nullptr;
+    head->prev = head->next = head;
+    return first;
+}
+
+int TimerWheel::cascade(int level, int slot) {
+    // 先把整个链表摘下来, 重新分配时可能又挂回同一层
+    Node* node = detach(&slots[level][slot]);
+    while (node) {
+        Node* next = node->next;
+        link(node);
+        node = next;
+    }
+    return slot;
+}
+
+void TimerWheel::tick(std::vector<std::pair<Task*, Priority>>& due) {
+    int index = int(now_tick & (slot_num - 1));
+    // 第 0 层转完一圈, 上一层走一格; 上一层也转完一圈时再往上
+    if (index == 0 && cascade(1, int((now_tick >> level_bits) & (slot_num - 1))) == 0 &&
+        cascade(2, int((now_tick >> (2 * level_bits)) & (slot_num - 1))) == 0) {
+        cascade(3, int((now_tick >> (3 * level_bits)) & (slot_num - 1)));
+    }
+    now_tick++;
+
+    // 周期定时器可能重新挂回这个格子, 先摘下整个链表
+    Node* node = detach(&slots[0][index]);
+    while (node) {
+        Node* next = node->next;
+        due.push_back(std::make_pair(node->task, node->priority));
+        if (node->period) {
+            // 错过的周期不补, 从下一格开始
+            node->expire = std::max(node->expire + node->period, now_tick);
+            link(node);
+        } else {
+            count--;
+            freeNode(node);
+        }
+        node = next;
+    }
+}
+
+void* TimerWheel::threadFunc(void* data) {
+    TimerWheel* wheel = static_cast<TimerWheel*>(data);
+    std::vector<std::pair<Task*, Priority>> due;
+
+    pthread_mutex_lock(&wheel->mutex);
+    while (!wheel->stopping) {
+        uint64_t target = wheel->currentTick();
+        while (wheel->now_tick <= target && wheel->count > 0) {
+            wheel->tick(due);
+        }
+        if (wheel->count == 0 && wheel->now_tick <= target) {
+            // 没有定时器时不用一格一格地走
+            wheel->now_tick = target + 1;
+        }
+
+        if (!due.empty()) {
+            // 提交时不持有锁, Block 策略下可能要等注入队列的空位
+            pthread_mutex_unlock(&wheel->mutex);
+            for (size_t i = 0; i < due.size(); i++) wheel->pool->addTask(due[i].first, due[i].second);
+            due.clear();
+            pthread_mutex_lock(&wheel->mutex);
+            continue;
+        }
+
+        // 先读 wake_seq 再解锁, 之后的 add 和 stop 会让 futexWait 立即返回
+        // 只有比 sleep_until 更早到期的定时器才需要叫醒定时线程
+        uint32_t seq = wheel->wake_seq.load();
+        bool empty = wheel->count == 0;
+        wheel->sleep_until = empty ? UINT64_MAX : wheel->nextTick();
+        uint64_t next = wheel->start_time + wheel->sleep_until * tick_ns;
+        pthread_mutex_unlock(&wheel->mutex);
+        if (empty) {
+            futexWait(&wheel->wake_seq, seq);
+        } else {
+            uint64_t now = ThreadPool::nowNs();
+            if (next > now) {
+                futexWait(&wheel->wake_seq, seq, next - now);
+            }
+        }
+        pthread_mutex_lock(&wheel->mutex);
+        wheel->sleep_until = 0;
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+    return nullptr;
+}
+
+uint64_t TimerWheel::add(uint64_t delay, uint64_t period, Task* task, Priority priority) {
+    pthread_mutex_lock(&mutex);
+    if (stopping) {
+        pthread_mutex_unlock(&mutex);
+        return 0;
+    }
+
+    uint64_t now = ThreadPool::nowNs() - start_time;
+    if (count == 0) {
+        // 定时线程可能已经睡了很久, 直接把时间轮拨到现在
+        now_tick = std::max(now_tick, now / tick_ns);
+    }
+
+    Node* node = allocNode();
+    // 向上取整, 不会提前到期
+    node->expire = (now + delay + tick_ns - 1) / tick_ns;
+    node->period = period == 0 ? 0 : std::max<uint64_t>(1, (period + tick_ns / 2) / tick_ns);
+    node->task = task;
+    node->priority = priority;
+    link(node);
+    count++;
+    uint64_t id = (uint64_t(node->generation) << 32) | node->index;
+    // 定时线程睡眠的目标比它晚 (没有定时器时不限时地睡眠), 需要叫醒它重新计算
+    bool wake = node->expire < sleep_until;
+    pthread_mutex_unlock(&mutex);
+
+    if (wake) {
+        wake_seq.fetch_add(1);
+        futexWake(&wake_seq);
+    }
+    return id;
+}
+
+int TimerWheel::cancel(uint64_t id) {
+    uint32_t index = uint32_t(id);
+    uint32_t generation = uint32_t(id >> 32);
+    int ret = -1;
+    pthread_mutex_lock(&mutex);
+    if (index < nodes.size()) {
+        Node* node = &nodes[index];
+        if (node->active && node->generation == generation) {
+            unlink(node);
+            count--;
+            freeNode(node);
+            ret = 0;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void TimerWheel::stop(std::vector<Task*>* unrun) {
+    pthread_mutex_lock(&mutex);
+    if (stopping) {
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    stopping = true;
+    pthread_mutex_unlock(&mutex);
+    wake_seq.fetch_add(1);
+    futexWake(&wake_seq);
+    pthread_join(thread, nullptr);
+
+    // 定时线程已经退出, 不用再加锁
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].active) {
+            if (unrun) {
+                unrun->push_back(nodes[i].task);
+            }
+            freeNode(&nodes[i]);
+        }
+    }
+    for (int level = 0; level < level_num; level++) {
+        for (int slot = 0; slot < slot_num; slot++) {
+            slots[level][slot].prev = slots[level][slot].next = &slots[level][slot];
+        }
+    }
+    count = 0;
+}
+
+size_t TimerWheel::size() {
+    pthread_mutex_lock(&mutex);
+    size_t n = count;
+    pthread_mutex_unlock(&mutex);
+    return n;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+// 分层时间轮 (Varghese & Lauck, 结构与 Linux 早期的 timer wheel 相同)
+// 4 层, 每层 256 格, 一格 1 毫秒: 第 0 层覆盖 256 毫秒, 第 1 层 65 秒, 第 2 层 4.6 小时, 第 3 层 49 天
+// 插入和取消都是 O(1): 按到期时间算出格子, 挂到格子的双向链表上
+// 定时线程每走一格处理第 0 层的一个格子; 第 0 层转完一圈时, 把上一层当前格子里的定时器重新分配到下层
+// 中间的空格子不用醒来, 定时线程直接睡到下一个非空的格子或者下一次重新分配的时候
+// 到期的任务交给线程池的注入队列执行, 定时线程和工作线程都不会为了等待而阻塞
+class TimerWheel {
+public:
+    // 启动定时线程, 到期的任务提交给 pool
+    explicit TimerWheel(ThreadPool* pool);
+    ~TimerWheel();
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // delay 纳秒之后提交 task, period 不为 0 时之后每隔 period 纳秒再提交一次
+    // 返回定时器编号 (不为 0), 已经停止返回 0
+    uint64_t add(uint64_t delay, uint64_t period, Task* task, Priority priority);
+    // 取消还没有到期的定时器, 成功返回 0, 已经到期 (一次性的) 或者已经取消返回 -1
+    // 周期定时器恰好在到期时被取消, 正在提交的这一次仍会执行
+    int cancel(uint64_t id);
+    // 停止定时线程, 没有到期的任务放进 unrun (可以为 nullptr), 之后 add 返回 0
+    void stop(std::vector<Task*>* unrun);
+    size_t size();  // 没有到期的定时器数
+
+private:
+    struct Node {
+        Node* prev;
+        Node* next;
+        uint64_t expire;    // 到期的格子 (从 start_time 开始数)
+        uint64_t period;    // 周期 (格子数), 0 表示一次性的
+        Task* task;
+        uint32_t index;     // 在 nodes 中的下标
+        uint32_t generation;  // 每次分配加一, 和 index 一起组成定时器编号, 旧编号不会取消新定时器
+        Priority priority;
+        bool active;
+    };
+
+    enum {
+        level_bits = 8,
+        slot_num = 1 << level_bits,  // 每层的格子数
+        level_num = 4,
+    };
+
+    static void* threadFunc(void* data);
+    void link(Node* node);          // 按到期时间挂到对应的格子上
+    static void unlink(Node* node);
+    static Node* detach(Node* head);  // 把格子里的节点摘成以 nullptr 结尾的单链表返回, 格子变为空
+    int cascade(int level, int slot);  // 把上层一个格子里的定时器重新分配到下层, 返回 slot
+    void tick(std::vector<std::pair<Task*, Priority>>& due);  // 走一格, 到期的任务放进 due
+    uint64_t currentTick();         // 现在对应的格子
+    uint64_t nextTick();            // 下一个需要处理的格子 (第 0 层非空, 或者要从上层重新分配)
+    Node* allocNode();
+    void freeNode(Node* node);
+
+    ThreadPool* pool;
+    Node slots[level_num][slot_num];  // 每个格子一个哨兵节点, 双向循环链表
+    std::deque<Node> nodes;           // 所有节点, 扩容时已有节点的地址不变
+    Node* free_nodes;                 // 空闲节点链表, 用 next 连接
+    size_t count;                     // 没有到期的定时器数
+    uint64_t now_tick;                // 下一个要处理的格子
+    uint64_t sleep_until;             // 定时线程睡眠到这一格, 没有睡眠时为 0, 更早到期的定时器要叫醒它
+    uint64_t start_time;              // 第 0 格的时间 (nowNs)
+    bool stopping;
+
+    pthread_mutex_t mutex;            // 保护以上所有成员
+    pthread_t thread;
+    std::atomic<uint32_t> wake_seq;   // 定时线程在上面睡眠, 有新定时器或停止时加一
+
+    static const uint64_t tick_ns = 1000000;  // 一格的时间 (纳秒)
+};
@@ -0,0 +1,202 @@
+#include "trace.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "futex.h"
+
+// 所有 Tracer 的编号, 从 1 开始
+static std::atomic<uint64_t> tracer_ids(0);
+
+// 非工作线程缓存自己在某个 Tracer 中的缓冲区
+struct LocalTraceBuffer {
+    uint64_t tracer;
+    TraceBuffer* buffer;
+};
+static thread_local LocalTraceBuffer local_buffer = {0, nullptr};
+
+// 与 ThreadPool::nowNs 相同的时钟
+static uint64_t traceNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+TraceBuffer::TraceBuffer(size_t capacity) : head(0), tail(0), dropped(0) {
+    size_t n = 1;
+    while (n < capacity) n <<= 1;
+    events = new TraceEvent[n];
+    mask = n - 1;
+}
+
+Tracer::Tracer(int worker_num, size_t capacity)
+    : id(++tracer_ids), capacity(capacity), file(nullptr), first(true), dropped_before(0), stopping(0) {
+    for (int i = 0; i < worker_num; i++) {
+        worker_buffers.push_back(new TraceBuffer(capacity));
+    }
+    pthread_mutex_init(&buffer_mutex, nullptr);
+}
+
+Tracer::~Tracer() {
+    close();
+    for (size_t i = 0; i < worker_buffers.size(); i++) delete worker_buffers[i];
+    for (size_t i = 0; i < other_buffers.size(); i++) delete other_buffers[i];
+    pthread_mutex_destroy(&buffer_mutex);
+}
+
+int Tracer::open(const char* path) {
+    if (file) {
+        return -1;
+    }
+    file = fopen(path, "w");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    // 丢掉上次 close 之后才写进来的事件
+    auto skip = [](const TraceEvent&) {};
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < worker_buffers.size(); i++) {
+        worker_buffers[i]->drain(skip);
+        dropped += worker_buffers[i]->getDropped();
+    }
+    pthread_mutex_lock(&buffer_mutex);
+    for (size_t i = 0; i < other_buffers.size(); i++) {
+        other_buffers[i]->drain(skip);
+        dropped += other_buffers[i]->getDropped();
+    }
+    pthread_mutex_unlock(&buffer_mutex);
+    dropped_before = dropped;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    first = true;
+    for (size_t i = 0; i < worker_buffers.size(); i++) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%zu,\"args\":{\"name\":\"worker %zu\"}}",
+                first ? "" : ",\n", int(getpid()), i, i);
+        first = false;
+    }
+
+    stopping.store(0);
+    if (pthread_create(&flush_thread, nullptr, flushFunc, this) != 0) {
+        fclose(file);
+        file = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t Tracer::close() {
+    if (file == nullptr) {
+        return 0;
+    }
+
+    stopping.store(1);
+    futexWake(&stopping);
+    pthread_join(flush_thread, nullptr);
+
+    flush();
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    file = nullptr;
+
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < worker_buffers.size(); i++) dropped += worker_buffers[i]->getDropped();
+    pthread_mutex_lock(&buffer_mutex);
+    for (size_t i = 0; i < other_buffers.size(); i++) dropped += other_buffers[i]->getDropped();
+    pthread_mutex_unlock(&buffer_mutex);
+    return dropped - dropped_before;
+}
+
+void Tracer::record(int worker, TraceEvent::Type type, const void* task, const std::string* name) {
+    TraceBuffer* buffer = worker >= 0 ? worker_buffers[worker] : localBuffer();
+    TraceEvent e;
+    e.ts = traceNow();
+    e.task = task;
+    e.type = type;
+    size_t n = name ? std::min(name->size(), sizeof(e.name) - 1) : 0;
+    memcpy(e.name, name ? name->data() : "", n);
+    e.name[n] = '\0';
+    buffer->push(e);
+}
+
+TraceBuffer* Tracer::localBuffer() {
+    if (local_buffer.tracer != id) {
+        TraceBuffer* buffer = new TraceBuffer(capacity);
+        pthread_mutex_lock(&buffer_mutex);
+        other_buffers.push_back(buffer);
+        pthread_mutex_unlock(&buffer_mutex);
+        local_buffer.tracer = id;
+        local_buffer.buffer = buffer;
+    }
+    return local_buffer.buffer;
+}
+
+void* Tracer::flushFunc(void* data) {
+    Tracer* tracer = static_cast<Tracer*>(data);
+    while (tracer->stopping.load() == 0) {
+        futexWait(&tracer->stopping, 0, flush_interval);
+        tracer->flush();
+    }
+    return nullptr;
+}
+
+void Tracer::flush() {
+    for (size_t i = 0; i < worker_buffers.size(); i++) {
+        worker_buffers[i]->drain([this, i](const TraceEvent& e) { write(e, int(i)); });
+    }
+    pthread_mutex_lock(&buffer_mutex);
+    for (size_t i = 0; i < other_buffers.size(); i++) {
+        other_buffers[i]->drain([this, i](const TraceEvent& e) { write(e, other_tid + int(i)); });
+    }
+    pthread_mutex_unlock(&buffer_mutex);
+    fflush(file);
+}
+
+void Tracer::write(const TraceEvent& e, int tid) {
+    // 名称中的引号, 反斜杠和控制字符不能直接写进 JSON
+    char name[sizeof(e.name) * 6 + 8];
+    size_t n = 0;
+    for (const char* p = e.name; *p; p++) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            name[n++] = '\\';
+            name[n++] = char(c);
+        } else if (c < 0x20) {
+            n += snprintf(name + n, sizeof(name) - n, "\\u%04x", c);
+        } else {
+            name[n++] = char(c);
+        }
+    }
+    name[n] = '\0';
+    if (n == 0) {
+        strcpy(name, "task");
+    }
+
+    // Chrome trace 的时间单位是微秒
+    double ts = double(e.ts) / 1000;
+    int pid = int(getpid());
+    const char* sep = first ? "" : ",\n";
+    first = false;
+    switch (e.type) {
+        case TraceEvent::Enqueue:
+            // 提交点, 加一条连到开始执行处的箭头 (flow 事件), 中间的空白就是排队时间
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", sep, name, ts,
+                    pid, tid);
+            fprintf(file, ",\n{\"name\":\"queue\",\"cat\":\"queue\",\"ph\":\"s\",\"id\":\"%p\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    e.task, ts, pid, tid);
+            break;
+        case TraceEvent::Start:
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", sep, name, ts, pid, tid);
+            fprintf(file,
+                    ",\n{\"name\":\"queue\",\"cat\":\"queue\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"%p\",\"ts\":%.3f,\"pid\":%d,"
+                    "\"tid\":%d}",
+                    e.task, ts, pid, tid);
+            break;
+        case TraceEvent::End:
+            fprintf(file, "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", sep, ts, pid, tid);
+            break;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 任务跟踪 输出 Chrome trace 格式的 JSON (用 chrome://tracing 或 https://ui.perfetto.dev 打开)
+// 每个线程把事件写进自己的环形缓冲区, 不加锁也没有原子读改写
+// 后台线程定期把缓冲区中的事件写到文件; 缓冲区满时丢弃新事件并计数, 不会让干活的线程等待
+
+struct TraceEvent {
+    enum Type : uint8_t { Enqueue, Start, End };
+
+    uint64_t ts;       // ThreadPool::nowNs() 的时间
+    const void* task;  // 任务的地址, 用来把提交和开始执行连起来
+    uint8_t type;
+    char name[23];     // 任务名称的前 22 个字节
+};
+
+// 单生产者单消费者的环形缓冲区
+// 生产者是所属的线程, 消费者是刷新线程
+class TraceBuffer {
+public:
+    explicit TraceBuffer(size_t capacity);
+    ~TraceBuffer() { delete[] events; }
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+    // 只能由所属线程调用 满了返回 false
+    bool push(const TraceEvent& e) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        events[h & mask] = e;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能由刷新线程调用 对已写入的每个事件调用 f(e)
+    template <typename F>
+    void drain(F f) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (; t < h; t++) f(events[t & mask]);
+        tail.store(t, std::memory_order_release);
+    }
+
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    TraceEvent* events;
+    size_t mask;  // 容量减一, 容量是 2 的幂
+    // head 和 tail 分别由两个线程修改, 放在不同的 cache line 上
+    alignas(64) std::atomic<uint64_t> head;  // 写入的事件数
+    alignas(64) std::atomic<uint64_t> tail;  // 取走的事件数
+    std::atomic<uint64_t> dropped;           // 缓冲区满时丢弃的事件数, 只有所属线程修改
+};
+
+// 一个线程池的跟踪记录
+// 工作线程用各自下标对应的缓冲区, 其他线程 (提交任务或帮忙执行任务的线程) 第一次记录时分配一个
+class Tracer {
+public:
+    // 每个缓冲区可以存 capacity 个事件 (向上取到 2 的幂)
+    Tracer(int worker_num, size_t capacity);
+    ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // 打开文件并启动刷新线程, 失败返回 -1
+    int open(const char* path);
+    // 写完剩余的事件并关闭文件, 返回这次跟踪期间丢弃的事件数
+    uint64_t close();
+
+    // worker 为工作线程的下标, -1 表示其他线程
+    // 结束事件的 name 传 nullptr, 任务在 run 中可能已经释放了自己
+    void record(int worker, TraceEvent::Type type, const void* task, const std::string* name);
+
+private:
+    static void* flushFunc(void* data);  // 刷新线程
+    void flush();                        // 把所有缓冲区中的事件写到文件
+    void write(const TraceEvent& e, int tid);
+    TraceBuffer* localBuffer();          // 当前 (非工作) 线程的缓冲区
+
+    uint64_t id;  // 区分不同的 Tracer, 线程缓存的缓冲区只对同一个 Tracer 有效
+    size_t capacity;
+    std::vector<TraceBuffer*> worker_buffers;
+    std::vector<TraceBuffer*> other_buffers;  // 由 buffer_mutex 保护
+    pthread_mutex_t buffer_mutex;
+
+    FILE* file;
+    bool first;                    // 下一个事件是不是文件中的第一个
+    uint64_t dropped_before;       // open 时已经丢弃的事件数
+    pthread_t flush_thread;
+    std::atomic<uint32_t> stopping;  // 刷新线程在上面定时睡眠, close 时置 1 并唤醒
+
+    static const uint64_t flush_interval = 10000000;  // 刷新间隔 (纳秒)
+    static const int other_tid = 1000;                // 非工作线程在文件中的线程号从这里开始
+};
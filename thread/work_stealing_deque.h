@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Chase-Lev 工作窃取双端队列
+// 所有者线程在底部 (bottom) push / pop, 后进先出, 刚放进去的任务数据还在缓存里
+// 其他线程从顶部 (top) steal, 先进先出, 偷走的是最早放进去的 (通常也是最大的) 任务
+// 只有所有者和窃取者争抢最后一个元素时才需要 CAS, 其余情况没有锁也没有原子读改写
+//
+// 参考 "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al., PPoPP 2013)
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256) : top(0), bottom(0), retired(nullptr) {
+        array.store(new Array(capacity, nullptr), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        delete array.load(std::memory_order_relaxed);
+        while (retired) {
+            Array* prev = retired->prev;
+            delete retired;
+            retired = prev;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // 只能由所有者线程调用
+    void push(T* x) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, x);
+        // release 保证元素先写入, 窃取者看到新的 bottom 时一定能读到元素
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // 只能由所有者线程调用 队列为空返回 nullptr
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        // 先占住 bottom 再读 top, 与 steal 中先读 top 再读 bottom 对应
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // 已经空了 恢复 bottom
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* x = a->get(b);
+        if (t == b) {
+            // 最后一个元素 可能同时有窃取者在拿, 用 CAS 决定归谁
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                x = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // 任意线程都可以调用 队列为空或者与别人争抢失败返回 nullptr
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        Array* a = array.load(std::memory_order_acquire);
+        T* x = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return x;
+    }
+
+    // 近似的元素个数 并发修改时只能作为参考
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? size_t(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    // 环形数组 容量是 2 的幂, 下标对容量取模
+    struct Array {
+        Array(int64_t capacity, Array* prev)
+            : capacity(capacity), mask(capacity - 1), buffer(new std::atomic<T*>[capacity]), prev(prev) {}
+
+        ~Array() { delete[] buffer; }
+
+        T* get(int64_t i) const { return buffer[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T* x) { buffer[i & mask].store(x, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<T*>* buffer;
+        Array* prev;  // 扩容后被替换下来的旧数组
+    };
+
+    // 容量翻倍 把 [t, b) 拷贝到新数组
+    // 窃取者可能还在读旧数组, 所以旧数组不能马上释放, 挂到 retired 链表上, 析构时统一释放
+    Array* grow(Array* a, int64_t b, int64_t t) {
+        Array* bigger = new Array(a->capacity * 2, nullptr);
+        for (int64_t i = t; i < b; i++) {
+            bigger->put(i, a->get(i));
+        }
+        a->prev = retired;
+        retired = a;
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // top 和 bottom 分别被窃取者和所有者频繁修改, 放在不同的 cache line 上避免伪共享
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<Array*> array;
+    Array* retired;  // 旧数组链表 只有所有者线程访问
+};